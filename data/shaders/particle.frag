@@ -0,0 +1,11 @@
+#version 120
+
+uniform sampler2D tex;
+
+varying vec4 particleColor;
+
+void main (void) {
+    
+    gl_FragColor = texture2D(tex, gl_PointCoord) * particleColor;
+    
+}
@@ -0,0 +1,21 @@
+#version 120
+
+// per particle attributes, see ParticleRenderer::Vertex
+attribute vec3 position;
+attribute vec4 color;     // RGBA8, normalized
+attribute float size;     // half float
+attribute float age;      // 0 at birth .. 1 at end of life
+
+uniform vec2 sizeOverLife;   // size multiplier at birth and at death
+uniform float fadeStart;     // age where the particle starts to fade out
+
+varying vec4 particleColor;
+
+void main() {
+
+    gl_Position   = gl_ModelViewProjectionMatrix * vec4(position, 1.0);
+    gl_PointSize  = size * mix(sizeOverLife.x, sizeOverLife.y, age);
+    float fade    = 1.0 - smoothstep(fadeStart, 1.0, age);
+    particleColor = vec4(color.rgb, color.a * fade);
+
+}
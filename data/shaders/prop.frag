@@ -0,0 +1,13 @@
+#version 120
+
+uniform sampler2D tex;
+
+varying vec2 texCoordVarying;
+varying float shade;
+
+void main (void) {
+    
+    vec4 color   = texture2D(tex, texCoordVarying);
+    gl_FragColor = vec4(color.rgb * shade, color.a);
+    
+}
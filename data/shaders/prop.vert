@@ -0,0 +1,26 @@
+#version 120
+
+// per instance, see PropRenderer::Instance
+attribute vec3 instancePosition;
+attribute vec2 instanceYawScale;    // radians about +y, uniform scale
+
+uniform mat4 propMatrix;      // the model and mesh node transform
+uniform vec3 lightDirection;  // world space, towards the light
+uniform float ambient;
+
+varying vec2 texCoordVarying;
+varying float shade;
+
+void main() {
+
+    float c     = cos(instanceYawScale.x);
+    float s     = sin(instanceYawScale.x);
+    mat3 yaw    = mat3(c, 0.0, -s,  0.0, 1.0, 0.0,  s, 0.0, c);
+    vec3 world  = yaw * (propMatrix * gl_Vertex).xyz * instanceYawScale.y + instancePosition;
+    vec3 n      = normalize(yaw * mat3(propMatrix) * gl_Normal);
+
+    gl_Position     = gl_ModelViewProjectionMatrix * vec4(world, 1.0);
+    texCoordVarying = gl_MultiTexCoord0.xy;
+    shade           = ambient + (1.0 - ambient) * abs(dot(n, lightDirection));
+
+}
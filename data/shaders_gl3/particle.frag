@@ -0,0 +1,12 @@
+#version 150
+
+uniform sampler2D tex;
+
+in vec4 particleColor;
+out vec4 outputColor;
+
+void main (void) {
+    
+    outputColor = texture(tex, gl_PointCoord) * particleColor;
+    
+}
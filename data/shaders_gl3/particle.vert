@@ -0,0 +1,22 @@
+#version 150
+
+// per particle attributes, see ParticleRenderer::Vertex
+in vec3 position;
+in vec4 color;     // RGBA8, normalized
+in float size;     // half float
+in float age;      // 0 at birth .. 1 at end of life
+
+uniform mat4 modelViewProjectionMatrix;
+uniform vec2 sizeOverLife;   // size multiplier at birth and at death
+uniform float fadeStart;     // age where the particle starts to fade out
+
+out vec4 particleColor;
+
+void main() {
+
+    gl_Position   = modelViewProjectionMatrix * vec4(position, 1.0);
+    gl_PointSize  = size * mix(sizeOverLife.x, sizeOverLife.y, age);
+    float fade    = 1.0 - smoothstep(fadeStart, 1.0, age);
+    particleColor = vec4(color.rgb, color.a * fade);
+
+}
@@ -0,0 +1,14 @@
+#version 150
+
+uniform sampler2D tex;
+
+in vec2 texCoordVarying;
+in float shade;
+out vec4 outputColor;
+
+void main (void) {
+    
+    vec4 color  = texture(tex, texCoordVarying);
+    outputColor = vec4(color.rgb * shade, color.a);
+    
+}
@@ -1,12 +1,14 @@
-#ifdef GL_ES
+#version 300 es
 // define default precision for float, vec, mat.
 precision highp float;
-#endif
 
 uniform sampler2D tex;
 
+in vec4 particleColor;
+out vec4 outputColor;
+
 void main (void) {
     
-    gl_FragColor = texture2D(tex, gl_TexCoord[0].st) * gl_Color;
+    outputColor = texture(tex, gl_PointCoord) * particleColor;
     
-}
\ No newline at end of file
+}
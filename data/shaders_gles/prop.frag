@@ -0,0 +1,16 @@
+#version 300 es
+// define default precision for float, vec, mat.
+precision highp float;
+
+uniform sampler2D tex;
+
+in vec2 texCoordVarying;
+in float shade;
+out vec4 outputColor;
+
+void main (void) {
+    
+    vec4 color  = texture(tex, texCoordVarying);
+    outputColor = vec4(color.rgb * shade, color.a);
+    
+}
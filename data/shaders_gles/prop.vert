@@ -0,0 +1,32 @@
+#version 300 es
+
+// per vertex, bound by ofVbo
+in vec4 position;
+in vec3 normal;
+in vec2 texcoord;
+
+// per instance, see PropRenderer::Instance
+in vec3 instancePosition;
+in vec2 instanceYawScale;    // radians about +y, uniform scale
+
+uniform mat4 modelViewProjectionMatrix;
+uniform mat4 propMatrix;      // the model and mesh node transform
+uniform vec3 lightDirection;  // world space, towards the light
+uniform float ambient;
+
+out vec2 texCoordVarying;
+out float shade;
+
+void main() {
+
+    float c     = cos(instanceYawScale.x);
+    float s     = sin(instanceYawScale.x);
+    mat3 yaw    = mat3(c, 0.0, -s,  0.0, 1.0, 0.0,  s, 0.0, c);
+    vec3 world  = yaw * (propMatrix * position).xyz * instanceYawScale.y + instancePosition;
+    vec3 n      = normalize(yaw * mat3(propMatrix) * normal);
+
+    gl_Position     = modelViewProjectionMatrix * vec4(world, 1.0);
+    texCoordVarying = texcoord;
+    shade           = ambient + (1.0 - ambient) * abs(dot(n, lightDirection));
+
+}
@@ -0,0 +1,202 @@
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "AllocTracker.h"
+
+static const char *tagNames[NUM_ALLOC_TAGS] = {
+	"other", "particles", "emitters", "octree", "snapshot", "renderer", "props"
+};
+
+const char * AllocTracker::getTagName(int tag) {
+	return tag >= 0 && tag < NUM_ALLOC_TAGS ? tagNames[tag] : "all";
+}
+
+#ifdef COUNTRYROADS_TRACK_ALLOCS
+
+// Counters are plain atomics with static storage, so they work before any
+// constructor has run (operator new is called during static init).
+//
+struct TagCounters {
+	std::atomic<uint64_t> allocs;
+	std::atomic<uint64_t> frees;
+	std::atomic<uint64_t> bytesAllocated;
+	std::atomic<uint64_t> bytesFreed;
+	std::atomic<int64_t> liveBytes;
+	std::atomic<int64_t> peakBytes;
+};
+static TagCounters counters[NUM_ALLOC_TAGS];
+static thread_local int currentTag = ALLOC_OTHER;
+static thread_local uint64_t threadAllocs = 0;
+
+// every block carries its size and tag in front, keeping 16 byte alignment
+//
+struct alignas(16) BlockHeader {
+	uint64_t size;
+	uint64_t tag;
+};
+
+static void * trackedAlloc(size_t size) {
+	BlockHeader *h = (BlockHeader *)malloc(size + sizeof(BlockHeader));
+	if (h == NULL) throw std::bad_alloc();
+	int tag = currentTag;
+	h->size = size;
+	h->tag = tag;
+
+	TagCounters &c = counters[tag];
+	c.allocs.fetch_add(1, std::memory_order_relaxed);
+	c.bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+	int64_t live = c.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	int64_t peak = c.peakBytes.load(std::memory_order_relaxed);
+	while (live > peak && !c.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+	threadAllocs++;
+	return h + 1;
+}
+
+static void trackedFree(void *p) {
+	if (p == NULL) return;
+	BlockHeader *h = (BlockHeader *)p - 1;
+	TagCounters &c = counters[h->tag];
+	c.frees.fetch_add(1, std::memory_order_relaxed);
+	c.bytesFreed.fetch_add(h->size, std::memory_order_relaxed);
+	c.liveBytes.fetch_sub(h->size, std::memory_order_relaxed);
+	free(h);
+}
+
+void * operator new(size_t size) { return trackedAlloc(size); }
+void * operator new[](size_t size) { return trackedAlloc(size); }
+void * operator new(size_t size, const std::nothrow_t &) noexcept {
+	try { return trackedAlloc(size); } catch (...) { return NULL; }
+}
+void * operator new[](size_t size, const std::nothrow_t &) noexcept {
+	try { return trackedAlloc(size); } catch (...) { return NULL; }
+}
+void operator delete(void *p) noexcept { trackedFree(p); }
+void operator delete[](void *p) noexcept { trackedFree(p); }
+void operator delete(void *p, size_t) noexcept { trackedFree(p); }
+void operator delete[](void *p, size_t) noexcept { trackedFree(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { trackedFree(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { trackedFree(p); }
+
+bool AllocTracker::isEnabled() { return true; }
+
+static AllocTracker::Stats read(int tag) {
+	AllocTracker::Stats s;
+	const TagCounters &c = counters[tag];
+	s.allocs = c.allocs.load(std::memory_order_relaxed);
+	s.frees = c.frees.load(std::memory_order_relaxed);
+	s.bytesAllocated = c.bytesAllocated.load(std::memory_order_relaxed);
+	s.bytesFreed = c.bytesFreed.load(std::memory_order_relaxed);
+	s.liveBytes = c.liveBytes.load(std::memory_order_relaxed);
+	s.peakBytes = c.peakBytes.load(std::memory_order_relaxed);
+	return s;
+}
+
+static void add(AllocTracker::Stats &sum, const AllocTracker::Stats &s) {
+	sum.allocs += s.allocs;
+	sum.frees += s.frees;
+	sum.bytesAllocated += s.bytesAllocated;
+	sum.bytesFreed += s.bytesFreed;
+	sum.liveBytes += s.liveBytes;
+	sum.peakBytes += s.peakBytes;
+	sum.peakFrameAllocs += s.peakFrameAllocs;
+}
+
+// totals at the start of the current frame, and the last frame's counts
+//
+static AllocTracker::Stats frameStart[NUM_ALLOC_TAGS];
+static AllocTracker::Stats lastFrame[NUM_ALLOC_TAGS];
+static uint64_t peakFrameAllocs[NUM_ALLOC_TAGS];
+static bool frameStarted = false;
+
+AllocTracker::Stats AllocTracker::getTotals(int tag) {
+	if (tag >= 0) {
+		Stats s = read(tag);
+		s.peakFrameAllocs = peakFrameAllocs[tag];
+		return s;
+	}
+	Stats sum;
+	for (int t = 0; t < NUM_ALLOC_TAGS; t++)
+		add(sum, getTotals(t));
+	return sum;
+}
+
+void AllocTracker::beginFrame() {
+	for (int t = 0; t < NUM_ALLOC_TAGS; t++) {
+		Stats now = read(t);
+		Stats &f = lastFrame[t];
+		f.allocs = now.allocs - frameStart[t].allocs;
+		f.frees = now.frees - frameStart[t].frees;
+		f.bytesAllocated = now.bytesAllocated - frameStart[t].bytesAllocated;
+		f.bytesFreed = now.bytesFreed - frameStart[t].bytesFreed;
+		f.liveBytes = now.liveBytes;
+		f.peakBytes = now.peakBytes;
+		if (frameStarted && f.allocs > peakFrameAllocs[t]) peakFrameAllocs[t] = f.allocs;
+		f.peakFrameAllocs = peakFrameAllocs[t];
+		frameStart[t] = now;
+	}
+	frameStarted = true;
+}
+
+AllocTracker::Stats AllocTracker::getFrame(int tag) {
+	if (tag >= 0) return lastFrame[tag];
+	Stats sum;
+	for (int t = 0; t < NUM_ALLOC_TAGS; t++)
+		add(sum, lastFrame[t]);
+	return sum;
+}
+
+uint64_t AllocTracker::getCount() {
+	uint64_t n = 0;
+	for (int t = 0; t < NUM_ALLOC_TAGS; t++)
+		n += counters[t].allocs.load(std::memory_order_relaxed);
+	return n;
+}
+
+uint64_t AllocTracker::getThreadCount() { return threadAllocs; }
+
+AllocTagScope::AllocTagScope(AllocTag tag) {
+	previous = currentTag;
+	currentTag = tag;
+}
+
+AllocTagScope::~AllocTagScope() {
+	currentTag = previous;
+}
+
+#else
+
+bool AllocTracker::isEnabled() { return false; }
+AllocTracker::Stats AllocTracker::getTotals(int) { return Stats(); }
+void AllocTracker::beginFrame() {}
+AllocTracker::Stats AllocTracker::getFrame(int) { return Stats(); }
+uint64_t AllocTracker::getCount() { return 0; }
+uint64_t AllocTracker::getThreadCount() { return 0; }
+AllocTagScope::AllocTagScope(AllocTag) : previous(0) {}
+AllocTagScope::~AllocTagScope() {}
+
+#endif
+
+//  one line per tag:  frame allocs / frees / KB, live KB, peak KB and the
+//  most allocations in a frame
+//
+std::string AllocTracker::getReport() {
+	if (!isEnabled()) return "heap tracking off (define COUNTRYROADS_TRACK_ALLOCS and rebuild, see README.md)\n";
+
+	char line[160];
+	std::string str = "heap        allocs  frees  frame KB   live KB   peak KB  max/frame\n";
+	for (int tag = 0; tag < NUM_ALLOC_TAGS; tag++) {
+		Stats f = getFrame(tag);
+		snprintf(line, sizeof(line), "%-10s %7llu %6llu %9.1f %9.1f %9.1f %10llu\n", getTagName(tag),
+			(unsigned long long)f.allocs, (unsigned long long)f.frees, f.bytesAllocated / 1024.0,
+			f.liveBytes / 1024.0, f.peakBytes / 1024.0, (unsigned long long)f.peakFrameAllocs);
+		str += line;
+	}
+	Stats f = getFrame();
+	snprintf(line, sizeof(line), "%-10s %7llu %6llu %9.1f %9.1f %9.1f %10llu\n", "all",
+		(unsigned long long)f.allocs, (unsigned long long)f.frees, f.bytesAllocated / 1024.0,
+		f.liveBytes / 1024.0, f.peakBytes / 1024.0, (unsigned long long)f.peakFrameAllocs);
+	str += line;
+	return str;
+}
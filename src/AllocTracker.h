@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+//  Heap allocation tracking, per frame and per subsystem.
+//
+//  Built with COUNTRYROADS_TRACK_ALLOCS defined, the global operator new and
+//  delete are replaced to count allocations, frees and bytes.  Each
+//  allocation is charged to the tag of the innermost ALLOC_TAG(tag) scope
+//  on its thread (ALLOC_OTHER outside of any), and its free to the same
+//  tag.  beginFrame() closes a frame, so getFrame() gives what happened
+//  during the last one.  Without the define nothing is counted, the
+//  ALLOC_TAG scopes compile to nothing and every count stays 0.
+//
+#ifdef COUNTRYROADS_TRACK_ALLOCS
+#define ALLOC_TAG_CONCAT_(a, b) a##b
+#define ALLOC_TAG_CONCAT(a, b) ALLOC_TAG_CONCAT_(a, b)
+#define ALLOC_TAG(tag) AllocTagScope ALLOC_TAG_CONCAT(allocTag, __LINE__)(tag)
+#else
+#define ALLOC_TAG(tag) ((void)0)
+#endif
+
+enum AllocTag {
+	ALLOC_OTHER,
+	ALLOC_PARTICLES,    // particle system update, expiry
+	ALLOC_EMITTERS,     // spawning
+	ALLOC_OCTREE,       // building and querying the octree and SDF
+	ALLOC_SNAPSHOT,     // simulation snapshots for the renderer
+	ALLOC_RENDERER,     // particle and prop vertex buffers
+	ALLOC_PROPS,        // prop scatter chunks
+	NUM_ALLOC_TAGS
+};
+
+class AllocTracker {
+public:
+	struct Stats {
+		uint64_t allocs = 0;
+		uint64_t frees = 0;
+		uint64_t bytesAllocated = 0;
+		uint64_t bytesFreed = 0;
+		int64_t liveBytes = 0;          // allocated and not freed yet
+		int64_t peakBytes = 0;          // high water mark of liveBytes
+		uint64_t peakFrameAllocs = 0;   // most allocations in one frame
+	};
+
+	static bool isEnabled();
+	static const char * getTagName(int tag);
+
+	// since startup.  tag -1 is the sum over all tags (the peak of the sum
+	// isn't tracked, it's the sum of the peaks).
+	//
+	static Stats getTotals(int tag = -1);
+
+	// end the current frame and start the next one.  Call from one thread.
+	// The first call only starts the first frame (startup isn't a frame).
+	//
+	static void beginFrame();
+
+	// counts during the last complete frame (live and peak bytes as of its end)
+	//
+	static Stats getFrame(int tag = -1);
+
+	// table of the last frame and the peaks per tag
+	//
+	static std::string getReport();
+
+	// allocations since startup, all threads or the calling thread only
+	//
+	static uint64_t getCount();
+	static uint64_t getThreadCount();
+};
+
+//  Charges the heap allocations of its thread to tag while it lives, see
+//  ALLOC_TAG
+//
+class AllocTagScope {
+public:
+	AllocTagScope(AllocTag tag);
+	~AllocTagScope();
+
+private:
+	int previous;
+};
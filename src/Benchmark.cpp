@@ -0,0 +1,391 @@
+
+#include <chrono>
+#include <fstream>
+#include "Benchmark.h"
+#include "TerrainGen.h"
+#include "Octree.h"
+#include "OctreeT.h"
+#include "TerrainPatches.h"
+#include "ParticleSystem.h"
+#include "ParticleEmitter.h"
+#include "JobPool.h"
+#include "PropScatter.h"
+#include "OcclusionCuller.h"
+#include "Random.h"
+
+bool parseBenchOptions(int argc, char *argv[], BenchOptions &opts, bool &ok) {
+	ok = true;
+	bool bench = false;
+	for (int i = 1; i < argc; i++) {
+		if (string(argv[i]) == "--bench") bench = true;
+	}
+	if (!bench) return false;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--bench") continue;
+		else if (arg == "--filter" && hasValue) opts.filter = argv[++i];
+		else if (arg == "--json" && hasValue) opts.jsonPath = argv[++i];
+		else if (arg == "--quick") opts.quick = true;
+		else {
+			cout << "unknown or incomplete argument: " << arg << endl;
+			ok = false;
+		}
+	}
+	return true;
+}
+
+//  Runs and records the cases.  fn is one timed iteration; reset, if given,
+//  runs untimed before each iteration.
+//
+class BenchRunner {
+public:
+	BenchRunner(const BenchOptions &opts) : opts(opts) {
+		minTime = opts.quick ? 0.05 : 0.25;
+	}
+
+	bool enabled(const string &name) const {
+		return opts.filter.empty() || name.find(opts.filter) != string::npos;
+	}
+
+	template <typename Fn>
+	void run(const string &name, const string &params, int items, Fn fn) {
+		run(name, params, items, fn, []() {});
+	}
+
+	template <typename Fn, typename Reset>
+	void run(const string &name, const string &params, int items, Fn fn, Reset reset) {
+		typedef std::chrono::steady_clock Clock;
+		const int minIterations = 3;
+		const int maxIterations = 100000;
+
+		reset();
+		fn();      // warm up
+
+		vector<double> times;
+		double total = 0;
+		while ((total < minTime || times.size() < minIterations) && times.size() < maxIterations) {
+			reset();
+			Clock::time_point start = Clock::now();
+			fn();
+			double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+			times.push_back(us);
+			total += us * 1e-6;
+		}
+
+		BenchResult r;
+		r.name = name;
+		r.params = params;
+		r.items = items;
+		r.iterations = (int)times.size();
+		r.meanUs = total * 1e6 / times.size();
+		std::sort(times.begin(), times.end());
+		r.medianUs = times[times.size() / 2];
+		r.minUs = times[0];
+		results.push_back(r);
+
+		cout << ofToString(name, 24, ' ') << " " << ofToString(params, 22, ' ')
+			<< "  iters " << r.iterations
+			<< "  mean " << r.meanUs << " us  median " << r.medianUs << " us  min " << r.minUs << " us"
+			<< "  " << r.itemsPerSec() << " items/s" << endl;
+	}
+
+	string json() const {
+		string str = "{\n  \"benchmarks\": [\n";
+		for (int i = 0; i < results.size(); i++) {
+			const BenchResult &r = results[i];
+			str += "    { \"name\": \"" + r.name + "\", \"params\": \"" + r.params + "\"";
+			str += ", \"items\": " + ofToString(r.items);
+			str += ", \"iterations\": " + ofToString(r.iterations);
+			str += ", \"meanUs\": " + ofToString(r.meanUs);
+			str += ", \"medianUs\": " + ofToString(r.medianUs);
+			str += ", \"minUs\": " + ofToString(r.minUs);
+			str += ", \"itemsPerSec\": " + ofToString(r.itemsPerSec()) + " }";
+			str += (i + 1 < results.size()) ? ",\n" : "\n";
+		}
+		str += "  ]\n}\n";
+		return str;
+	}
+
+	vector<BenchResult> results;
+
+	// query results go here so the compiler can't drop the queries
+	//
+	volatile int sink = 0;
+
+private:
+	const BenchOptions &opts;
+	double minTime;
+};
+
+static void benchOctree(BenchRunner &bench) {
+	const int resolutions[] = { 64, 128, 256 };
+	const int levels[] = { 5, 7, 9 };
+	const int numQueries = 10000;
+
+	// skip building the test terrain if no case here is selected
+	//
+	const char *cases[] = { "octree_create", "octree_intersect_point", "octree_intersect_ray",
+		"octreet_create", "octreet_intersect_point", "column_heights" };
+	bool any = false;
+	for (const char *c : cases) any |= bench.enabled(c);
+	if (!any) return;
+
+	for (int res : resolutions) {
+		ofMesh terrain = makeTerrain(res, 400, 40);
+		int verts = terrain.getNumVertices();
+
+		for (int lvl : levels) {
+			string params = "verts=" + ofToString(verts) + " levels=" + ofToString(lvl);
+			if (bench.enabled("octree_create")) {
+				bench.run("octree_create", params, verts, [&]() {
+					Octree oct;
+					oct.create(terrain, lvl);
+				});
+			}
+		}
+
+		// queries on the default depth used by the app
+		//
+		Octree oct;
+		oct.create(terrain, 9);
+		vector<ofVec3f> points = makeQueryPoints(terrain, numQueries);
+		string params = "verts=" + ofToString(verts) + " levels=9";
+
+		if (bench.enabled("octree_intersect_point")) {
+			bench.run("octree_intersect_point", params, numQueries, [&]() {
+				int hits = 0;
+				const TreeNode *node;
+				for (int i = 0; i < numQueries; i++)
+					hits += oct.intersect(points[i], oct.root, node);
+				bench.sink += hits;
+			});
+		}
+		if (bench.enabled("octree_intersect_ray")) {
+			bench.run("octree_intersect_ray", params, numQueries, [&]() {
+				int hits = 0;
+				const TreeNode *node;
+				for (int i = 0; i < numQueries; i++) {
+					Ray ray(Vector3(points[i].x, 100, points[i].z), Vector3(0, -1, 0));
+					hits += oct.intersect(ray, oct.root, node);
+				}
+				bench.sink += hits;
+			});
+		}
+
+		// the compile-time configured tree on the same data
+		//
+		if (bench.enabled("octreet_create")) {
+			bench.run("octreet_create", "verts=" + ofToString(verts) + " TerrainOctree", verts, [&]() {
+				TerrainOctree t;
+				t.create(terrain);
+			});
+		}
+		TerrainOctree tree;
+		tree.create(terrain);
+		if (bench.enabled("octreet_intersect_point")) {
+			bench.run("octreet_intersect_point", "verts=" + ofToString(verts) + " TerrainOctree", numQueries, [&]() {
+				int hits = 0;
+				uint32_t leaf;
+				for (int i = 0; i < numQueries; i++)
+					hits += tree.intersect(points[i], leaf);
+				bench.sink += hits;
+			});
+		}
+
+		// the prop height queries, on the terrain octree and on the 16-bit
+		// patch trees that PropScatter and OcclusionCuller use
+		//
+		if (bench.enabled("column_heights")) {
+			vector<ofVec2f> xz;
+			for (const ofVec3f &p : points) xz.push_back(ofVec2f(p.x, p.z));
+			vector<float> heights(numQueries);
+			bench.run("column_heights", "verts=" + ofToString(verts) + " Octree", numQueries, [&]() {
+				oct.columnHeights(xz.data(), numQueries, heights.data());
+				bench.sink += heights[0] > 0;
+			});
+			TerrainPatches patches;
+			patches.create(terrain);
+			bench.run("column_heights", "verts=" + ofToString(verts) + " TerrainPatches", numQueries, [&]() {
+				patches.columnHeights(xz.data(), numQueries, heights.data());
+				bench.sink += heights[0] > 0;
+			});
+		}
+	}
+}
+
+static void benchBox(BenchRunner &bench) {
+	if (!bench.enabled("box_intersect")) return;
+
+	const int numRays = 100000;
+	CounterRNG rng(0, 2);
+	vector<Ray> rays;
+	rays.reserve(numRays);
+	for (int i = 0; i < numRays; i++) {
+		float r[4];
+		rng.uniform4(i, 0, r);
+		Vector3 origin(r[0] * 20 - 10, 20, r[1] * 20 - 10);
+		Vector3 dir(r[2] - 0.5f, -1, r[3] - 0.5f);
+		rays.push_back(Ray(origin, dir));
+	}
+	Box box(Vector3(-5, -5, -5), Vector3(5, 5, 5));
+	bench.run("box_intersect", "rays=" + ofToString(numRays), numRays, [&]() {
+		int hits = 0;
+		for (int i = 0; i < numRays; i++)
+			hits += box.intersect(rays[i], -1000, 1000);
+		bench.sink += hits;
+	});
+}
+
+static void benchParticles(BenchRunner &bench, JobPool &jobs) {
+	const int counts[] = { 1000, 10000, 100000, 1000000 };
+	const float dt = 1.0 / 120;
+
+	for (int n : counts) {
+		for (int threaded = 0; threaded < 2; threaded++) {
+			if (!bench.enabled("particle_update")) continue;
+
+			GravityForce grav(ofVec3f(0, -1, 0));
+			TurbulenceForce turb(ofVec3f(-1, 0, -1), ofVec3f(1, 0, 1));
+			ForcePipeline<GravityForce, TurbulenceForce> forces(&grav, &turb);
+
+			ParticleSystem sys;
+			sys.setCapacity(n);
+			sys.addForce(&forces);
+			if (threaded) sys.setJobPool(&jobs);
+
+			CounterRNG rng(0, 3);
+			for (int i = 0; i < n; i++) {
+				float r[4];
+				rng.uniform4(i, 0, r);
+				Particle p;
+				p.position = ofVec3f(r[0], r[1], r[2]) * 100;
+				p.lifespan = 1000000;
+				sys.add(p);
+			}
+
+			float time = 0;
+			string params = "n=" + ofToString(n) + (threaded ? " workers=" + ofToString(jobs.getNumThreads()) : " serial");
+			bench.run("particle_update", params, n, [&]() {
+				time += dt;
+				sys.update(dt, time);
+			});
+		}
+	}
+}
+
+static void benchSpawn(BenchRunner &bench) {
+	if (!bench.enabled("emitter_spawn")) return;
+
+	const int bursts[] = { 200, 1000, 10000 };
+	const EmitterType types[] = { DirectionalEmitter, RadialEmitter, SphereEmitter, DiscEmitter };
+	const char *typeNames[] = { "directional", "radial", "sphere", "disc" };
+
+	for (int burst : bursts) {
+		for (int t = 0; t < 4; t++) {
+			ParticleEmitter emitter;
+			emitter.sys->setCapacity(burst);
+			emitter.setEmitterType(types[t]);
+			emitter.setRandomLife(true);
+			bench.run("emitter_spawn", string(typeNames[t]) + " burst=" + ofToString(burst), burst,
+				[&]() { emitter.spawn(0, burst); },
+				[&]() { emitter.sys->particles.clear(); });
+		}
+	}
+}
+
+// placing the whole field, to see it can be redone at load time
+//
+static void benchScatter(BenchRunner &bench, JobPool &jobs) {
+	if (!bench.enabled("prop_scatter")) return;
+
+	const float densities[] = { 0.02, 0.1, 0.5 };
+	ofMesh terrain = makeTerrain(256, 400, 40);
+	TerrainPatches patches;
+	patches.create(terrain);
+
+	for (float density : densities) {
+		for (int threaded = 0; threaded < 2; threaded++) {
+			ScatterRule rule;
+			rule.density = density;
+			PropScatter scatter;
+			scatter.setup(patches, rule, 32, threaded ? &jobs : NULL);
+			scatter.load(ofVec3f(0, 0, 0), 1000);
+			int props = scatter.getNumProps();
+			string params = "density=" + ofToString(density) + " props=" + ofToString(props)
+				+ (threaded ? " workers=" + ofToString(jobs.getNumThreads()) : " serial");
+			bench.run("prop_scatter", params, props,
+				[&]() { scatter.load(ofVec3f(0, 0, 0), 1000); },
+				[&]() { scatter.setup(patches, rule, 32, threaded ? &jobs : NULL); });
+		}
+	}
+}
+
+// one frame of culling: rasterize the occluders and test a grid of boxes
+// from a camera low over the terrain, looking across it
+//
+static void benchCulling(BenchRunner &bench) {
+	if (!bench.enabled("occlusion_cull")) return;
+
+	const int resolutions[] = { 96, 160, 320 };
+	ofMesh terrain = makeTerrain(256, 400, 40);
+	TerrainPatches patches;
+	patches.create(terrain);
+
+	// the chunk boxes of the corn field
+	//
+	ScatterRule rule;
+	PropScatter scatter;
+	scatter.setup(patches, rule, 16, NULL);
+	scatter.load(ofVec3f(0, 0, 0), 1000);
+	vector<Box> boxes;
+	for (int c = 0; c < scatter.getNumChunks(); c++) boxes.push_back(scatter.getChunkBox(c));
+
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 4.0f / 3, 0.5f, 1000.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(-190, 30, -190), glm::vec3(0, 15, 0), glm::vec3(0, 1, 0));
+	glm::mat4 viewProjection = projection * view;
+
+	for (int res : resolutions) {
+		OcclusionCuller culler;
+		culler.setup(res, res * 3 / 4);
+		culler.setOccluders(patches);
+		culler.begin(viewProjection);
+		int culled = 0;
+		for (const Box &b : boxes) culled += !culler.isVisible(b);
+
+		string params = ofToString(culler.getWidth()) + "x" + ofToString(culler.getHeight())
+			+ " culled=" + ofToString(culled) + "/" + ofToString(boxes.size());
+		bench.run("occlusion_cull", params, (int)boxes.size(), [&]() {
+			culler.begin(viewProjection);
+			int visible = 0;
+			for (const Box &b : boxes) visible += culler.isVisible(b);
+			bench.sink += visible;
+		});
+	}
+}
+
+int runBenchmarks(const BenchOptions &opts) {
+	BenchRunner bench(opts);
+	JobPool jobs;
+
+	benchOctree(bench);
+	benchBox(bench);
+	benchParticles(bench, jobs);
+	benchSpawn(bench);
+	benchScatter(bench, jobs);
+	benchCulling(bench);
+
+	if (opts.jsonPath == "-") {
+		cout << bench.json();
+	}
+	else if (!opts.jsonPath.empty()) {
+		std::ofstream out(opts.jsonPath.c_str());
+		if (!out) {
+			cout << "Can't write: " << opts.jsonPath << endl;
+			return 1;
+		}
+		out << bench.json();
+	}
+	return 0;
+}
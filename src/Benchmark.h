@@ -0,0 +1,38 @@
+#pragma once
+#include "ofMain.h"
+
+//  Microbenchmarks for the hot paths: Octree/OctreeT create and queries,
+//  column heights (Octree and TerrainPatches), Box::intersect,
+//  ParticleSystem::update and ParticleEmitter::spawn.  Everything runs on
+//  synthetic terrain (TerrainGen.h), no assets or window needed.
+//
+//    CountryRoads --bench [--filter substring] [--json file] [--quick]
+//
+//  Each case runs until it has taken at least 0.25 sec (0.05 with --quick)
+//  and reports mean, median and min time per iteration and throughput.
+//
+struct BenchOptions {
+	string filter;
+	string jsonPath;
+	bool quick = false;
+};
+
+struct BenchResult {
+	string name;
+	string params;
+	int items;          // work items per iteration (queries, particles ...)
+	int iterations;
+	double meanUs;
+	double medianUs;
+	double minUs;
+	double itemsPerSec() const { return meanUs > 0 ? items / (meanUs * 1e-6) : 0; }
+};
+
+// returns true if the command line asks for benchmarks, see
+// parseHeadlessOptions
+//
+bool parseBenchOptions(int argc, char *argv[], BenchOptions &opts, bool &ok);
+
+// returns the process exit code
+//
+int runBenchmarks(const BenchOptions &opts);
@@ -0,0 +1,116 @@
+
+#include "ExpiryWheel.h"
+
+ExpiryWheel::ExpiryWheel(float tick, int slots) {
+	this->tick = tick;
+	buckets.resize(slots);
+}
+
+// change the tick length (sec).  Drops everything scheduled.
+//
+void ExpiryWheel::setTick(float t) {
+	tick = t;
+	clear();
+}
+
+void ExpiryWheel::clear() {
+	for (int i = 0; i < buckets.size(); i++)
+		buckets[i].clear();
+	far = std::priority_queue<Entry, vector<Entry>, std::greater<Entry> >();
+	numEntries = 0;
+}
+
+void ExpiryWheel::schedule(const ParticleStore &store, int i) {
+	if (store.lifespan[i] == -1) return;
+
+	Entry e;
+	e.handle = store.handle[i];
+	e.id = store.id[i];
+	e.due = toTick(store.birthtime[i] + store.lifespan[i]);
+	if (e.due < current) e.due = current;
+	numEntries++;
+	insert(e);
+}
+
+// in the wheel if it is due within one turn, on the heap otherwise
+//
+void ExpiryWheel::insert(const Entry &e) {
+	int64_t slots = buckets.size();
+	if (e.due - current < slots)
+		buckets[((e.due % slots) + slots) % slots].push_back(e);
+	else
+		far.push(e);
+}
+
+int ExpiryWheel::expire(ParticleStore &store, float time) {
+	int64_t now = toTick(time);
+	if (now < current) rebuild(store, now);    // time went backwards (reset)
+
+	// the bucket of the last tick is checked again: consecutive times can
+	// fall in the same tick, and particles due in it may not have expired yet
+	//
+	int64_t slots = buckets.size();
+	int64_t steps = std::min(now - current + 1, slots);
+	current = now;
+
+	// move the long lived particles that are now within one turn to the wheel
+	//
+	while (!far.empty() && far.top().due - current < slots) {
+		Entry e = far.top();
+		far.pop();
+		insert(e);
+	}
+
+	int removed = 0;
+	vector<Entry> &last = buckets[((now % slots) + slots) % slots];
+	for (int64_t t = now - steps + 1; t <= now; t++) {
+		vector<Entry> &bucket = buckets[((t % slots) + slots) % slots];
+		for (int k = 0; k < bucket.size(); ) {
+			Entry e = bucket[k];
+			if (e.due > now) {
+				k++;
+				continue;
+			}
+
+			// handle reused since the particle was scheduled
+			//
+			int i = store.indexOf(e.handle);
+			if (i < 0 || store.id[i] != e.id) {
+				bucket[k] = bucket.back();
+				bucket.pop_back();
+				numEntries--;
+				continue;
+			}
+
+			float life = store.lifespan[i];
+			if (life != -1 && time - store.birthtime[i] > life) {
+				store.remove(i);
+				bucket[k] = bucket.back();
+				bucket.pop_back();
+				numEntries--;
+				removed++;
+			}
+			else if (&bucket == &last) {
+				k++;
+			}
+			else {
+				// due but not expired yet, keep checking it every call
+				//
+				e.due = now;
+				last.push_back(e);
+				bucket[k] = bucket.back();
+				bucket.pop_back();
+			}
+		}
+	}
+	return removed;
+}
+
+// reschedule every particle in the store relative to tick "now"
+//
+void ExpiryWheel::rebuild(ParticleStore &store, int64_t now) {
+	clear();
+	current = now;
+	for (int i = 0; i < store.size(); i++)
+		schedule(store, i);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <queue>
+#include "ofMain.h"
+#include "ParticleStore.h"
+
+//  Timing wheel of particle deaths.
+//
+//  Each particle is put in the bucket of the tick it expires in, so finding
+//  the expired particles only touches the buckets that came due since the
+//  last call; the cost scales with the number of deaths, not with the number
+//  of live particles.  The wheel covers "slots" ticks ahead; particles that
+//  live longer (the ship, long lived harvest particles) wait in a heap until
+//  their tick comes within range.
+//
+//  Particles are referenced by their ParticleStore handle, and the id is
+//  kept to detect handles that were reused after the particle was removed
+//  some other way.  Expiry is exact: a particle is removed on the first call
+//  where time - birthtime > lifespan, like the full scan it replaces.
+//
+class ExpiryWheel {
+public:
+	ExpiryWheel(float tick = 1.0 / 120, int slots = 256);
+	void setTick(float tick);
+	void clear();
+
+	// schedule particle i of the store.  Particles with a lifespan of -1
+	// never expire and are not scheduled.
+	//
+	void schedule(const ParticleStore &store, int i);
+
+	// remove every particle that has expired at "time", returns the number
+	// removed.  Removal is swap-and-pop: the last particle moves into the
+	// hole, so a particle that never expires stays where it is.
+	//
+	int expire(ParticleStore &store, float time);
+
+	int size() const { return numEntries; }
+
+private:
+	struct Entry {
+		uint32_t handle;
+		uint32_t id;
+		int64_t due;       // first tick on which the particle may have expired
+		bool operator>(const Entry &e) const { return due > e.due; }
+	};
+	int64_t toTick(float time) const { return (int64_t)floor(time / tick); }
+	void insert(const Entry &e);
+	void rebuild(ParticleStore &store, int64_t now);
+
+	float tick;
+	int64_t current = 0;      // last tick processed
+	int numEntries = 0;
+	vector<vector<Entry> > buckets;
+	std::priority_queue<Entry, vector<Entry>, std::greater<Entry> > far;
+};
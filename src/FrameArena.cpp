@@ -0,0 +1,62 @@
+
+#include <cstdlib>
+#include <new>
+#include "FrameArena.h"
+
+FrameArena::FrameArena(size_t capacity) : capacity(capacity) {
+	block = (char *)malloc(capacity);
+	if (block == nullptr) throw std::bad_alloc();
+}
+
+FrameArena::~FrameArena() {
+	reset();
+	free(block);
+}
+
+FrameArena & FrameArena::local() {
+	static thread_local FrameArena arena;
+	return arena;
+}
+
+void * FrameArena::allocate(size_t size, size_t align) {
+	size_t start = (used + align - 1) & ~(align - 1);
+	if (start + size <= capacity) {
+		used = start + size;
+		if (used > highWater) highWater = used;
+		return block + start;
+	}
+
+	// out of room, use the heap until the arena is rewound past it
+	//
+	void *p = malloc(size + align);
+	if (p == nullptr) throw std::bad_alloc();
+	overflow.push_back(Spill{ p, size + align });
+	spilled += size + align;
+	if (used + spilled > peak) peak = used + spilled;
+	spills++;
+	uintptr_t aligned = ((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1);
+	return (void *)aligned;
+}
+
+void FrameArena::rewind(const Mark &mark) {
+	used = mark.used;
+	while (overflow.size() > mark.spills) {
+		free(overflow.back().p);
+		spilled -= overflow.back().size;
+		overflow.pop_back();
+	}
+	if (used > 0 || !overflow.empty() || peak == 0) return;
+
+	// empty after spilling: grow so it all fits next time
+	//
+	size_t needed = peak;
+	peak = 0;
+	if (needed > capacity) {
+		char *bigger = (char *)malloc(needed);
+		if (bigger != nullptr) {
+			free(block);
+			block = bigger;
+			capacity = needed;
+		}
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+//  Bump allocator for short lived memory in the per frame code.
+//
+//  allocate() hands out the next bytes of one block and nothing is freed on
+//  its own: reset() at the end of the frame (or an ArenaScope) gives it all
+//  back at once.  When the block runs out, allocations spill to the heap;
+//  a rewind frees the spills made after its mark, and once the arena is
+//  empty the block grows to the most that was in use at one time, so a
+//  steady frame ends up not touching the heap at all.
+//
+//  Every thread has its own arena (local()), so there is no locking.
+//  Memory from an arena must not outlive the frame or scope.
+//
+class FrameArena {
+public:
+	FrameArena(size_t capacity = 64 * 1024);
+	~FrameArena();
+	FrameArena(const FrameArena &) = delete;
+	FrameArena & operator=(const FrameArena &) = delete;
+
+	// arena of the calling thread
+	//
+	static FrameArena & local();
+
+	void * allocate(size_t size, size_t align = alignof(std::max_align_t));
+	template <typename T> T * allocate(size_t n) {
+		return (T *)allocate(n * sizeof(T), alignof(T));
+	}
+
+	// everything allocated after getMark() is given back by rewind(mark).
+	// The spill count is part of the mark, a spill doesn't move used.
+	//
+	struct Mark {
+		size_t used = 0;
+		size_t spills = 0;
+	};
+	Mark getMark() const { return Mark{ used, overflow.size() }; }
+	void rewind(const Mark &mark);
+	void reset() { rewind(Mark()); }
+
+	size_t getUsed() const { return used; }
+	size_t getCapacity() const { return capacity; }
+	size_t getHighWater() const { return highWater; }
+	int getSpills() const { return spills; }    // heap allocations since startup
+
+private:
+	char *block;
+	size_t capacity;
+	size_t used = 0;
+	size_t highWater = 0;
+	size_t spilled = 0;               // bytes on the heap now
+	size_t peak = 0;                  // most bytes in use at once since the arena was last empty
+	struct Spill {
+		void *p;
+		size_t size;
+	};
+	std::vector<Spill> overflow;
+	int spills = 0;
+};
+
+//  Rewinds the arena to where it was when the scope started
+//
+class ArenaScope {
+public:
+	ArenaScope(FrameArena &arena) : arena(arena), mark(arena.getMark()) {}
+	~ArenaScope() { arena.rewind(mark); }
+
+private:
+	FrameArena &arena;
+	FrameArena::Mark mark;
+};
+
+//  Growable array in a FrameArena, for plain data (no constructors or
+//  destructors are run).  Growing copies into a new arena allocation and
+//  leaves the old one until the arena is rewound, so reserve what you can.
+//
+template <typename T>
+class ArenaVector {
+public:
+	static_assert(std::is_trivially_copyable<T>::value, "ArenaVector only holds plain data");
+
+	ArenaVector(FrameArena &arena, int reserve = 16) : arena(arena) {
+		grow(reserve);
+	}
+
+	void push_back(const T &v) {
+		if (count == cap) grow(cap * 2);
+		items[count++] = v;
+	}
+	void clear() { count = 0; }
+
+	int size() const { return count; }
+	bool empty() const { return count == 0; }
+	T & operator[](int i) { return items[i]; }
+	const T & operator[](int i) const { return items[i]; }
+	T * data() { return items; }
+	T * begin() { return items; }
+	T * end() { return items + count; }
+	const T * begin() const { return items; }
+	const T * end() const { return items + count; }
+
+private:
+	void grow(int n) {
+		if (n < 4) n = 4;
+		T *p = arena.allocate<T>(n);
+		if (count > 0) memcpy(p, items, count * sizeof(T));
+		items = p;
+		cap = n;
+	}
+
+	FrameArena &arena;
+	T *items = nullptr;
+	int count = 0;
+	int cap = 0;
+};
@@ -0,0 +1,160 @@
+
+#include <fstream>
+#include "Headless.h"
+#include "Simulation.h"
+#include "SimClock.h"
+#include "Util.h"
+#include "TerrainGen.h"
+#include "Profiler.h"
+#include "InputRecorder.h"
+#include "AllocTracker.h"
+
+bool parseHeadlessOptions(int argc, char *argv[], HeadlessOptions &opts, bool &ok) {
+	ok = true;
+
+	// other arguments are left alone unless we run headless (IDEs pass their own)
+	//
+	bool headless = false;
+	for (int i = 1; i < argc; i++) {
+		if (string(argv[i]) == "--headless") headless = true;
+	}
+	if (!headless) return false;
+
+	for (int i = 1; i < argc; i++) {
+		string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--headless") continue;
+		else if (arg == "--steps" && hasValue) opts.steps = atoi(argv[++i]);
+		else if (arg == "--dt" && hasValue) opts.dt = atof(argv[++i]);
+		else if (arg == "--json" && hasValue) opts.jsonPath = argv[++i];
+		else if (arg == "--trace" && hasValue) opts.tracePath = argv[++i];
+		else if (arg == "--replay" && hasValue) opts.replayPath = argv[++i];
+		else if (arg == "--terrain" && hasValue) opts.terrainPath = argv[++i];
+		else if (arg == "--ship" && hasValue) opts.shipPath = argv[++i];
+		else if (arg == "--no-thrust") opts.thrust = false;
+		else if (arg == "--no-harvest") opts.harvest = false;
+		else if (arg == "--serial-stages") opts.parallelStages = false;
+		else {
+			cout << "unknown or incomplete argument: " << arg << endl;
+			ok = false;
+		}
+	}
+	// --steps 0 (the default) means 1200, or the whole replayed recording
+	//
+	if (opts.steps < 0) {
+		cout << "--steps can't be negative" << endl;
+		ok = false;
+	}
+	if (opts.dt <= 0) {
+		cout << "--dt must be positive" << endl;
+		ok = false;
+	}
+	return true;
+}
+
+int runHeadless(const HeadlessOptions &opts) {
+	// "synthetic" runs on generated terrain instead of the game assets
+	//
+	ofMesh terrain;
+	if (opts.terrainPath == "synthetic") {
+		terrain = makeTerrain(256, 400, 40);
+	}
+	else if (!loadObjMesh(opts.terrainPath, terrain)) {
+		cout << "Can't load terrain: " << opts.terrainPath << endl;
+		return 1;
+	}
+
+	// the ship only matters through its bounding box
+	//
+	ofMesh shipMesh;
+	ofVec3f shipMin, shipMax;
+	if (!loadObjMesh(opts.shipPath, shipMesh)) {
+		cout << "Can't load ship: " << opts.shipPath << endl;
+		return 1;
+	}
+	meshBounds(shipMesh, shipMin, shipMax);
+
+	// a replay is flown by its recorded controls at its own step size
+	//
+	InputRecorder input;
+	bool replay = !opts.replayPath.empty();
+	float dt = opts.dt;
+	int steps = opts.steps > 0 ? opts.steps : 1200;
+	if (replay) {
+		if (!input.load(opts.replayPath)) return 1;
+		dt = input.dt;
+		if (opts.steps == 0) steps = input.steps;
+		cout << "replaying " << input.events.size() << " events over " << input.steps
+			<< " steps of " << dt << " sec" << endl;
+	}
+
+	Simulation sim;
+	sim.bParallelStages = opts.parallelStages;
+	sim.setup(terrain, shipMin, shipMax);
+	if (!replay && opts.thrust) sim.thrusterEmitter.start();
+	if (!replay && opts.harvest) sim.cornEmitter.start();
+
+	// heap allocations per step, in builds with COUNTRYROADS_TRACK_ALLOCS.
+	// The first half of the run is warm up (pools and arenas growing).
+	//
+	uint64_t warmupAllocs = 0, steadyAllocs = 0, steadyMax = 0;
+
+	AllocTracker::beginFrame();      // setup isn't a step
+
+	SimClock clock;
+	clock.setStep(dt);
+	for (int i = 0; i < steps; i++) {
+		PROFILE_FRAME();
+		if (replay) input.replay(sim, clock.getStepCount());
+		clock.tick();
+		sim.step(clock.getStep(), clock.getTime());
+
+		AllocTracker::beginFrame();
+		uint64_t allocs = AllocTracker::getFrame().allocs;
+		if (i < steps / 2) {
+			warmupAllocs += allocs;
+		}
+		else {
+			steadyAllocs += allocs;
+			steadyMax = std::max(steadyMax, allocs);
+		}
+	}
+
+	cout << sim.getTimingReport();
+	cout << "ship position: " << sim.currentPos << "  altitude: " << sim.altitude << endl;
+	cout << "particles: thrust " << sim.thrusterEmitter.sys->particles.size()
+		<< "  corn " << sim.cornEmitter.sys->particles.size() << endl;
+	cout << "parallel particle updates: thrust " << sim.thrusterEmitter.sys->parallelUpdates
+		<< "  corn " << sim.cornEmitter.sys->parallelUpdates << endl;
+	if (AllocTracker::isEnabled()) {
+		cout << "heap allocations: warm up " << warmupAllocs << ", steady state " << steadyAllocs
+			<< " (max " << steadyMax << " per step)" << endl;
+		cout << "last step:" << endl << AllocTracker::getReport();
+	}
+
+	// only meaningful when the whole recording was flown
+	//
+	bool diverged = false;
+	if (replay && steps == input.steps) {
+		diverged = sim.trajectoryHash != input.hash;
+		cout << "replay: trajectory " << (diverged ? "DIFFERS from" : "matches") << " the recording" << endl;
+	}
+
+	if (!opts.tracePath.empty()) {
+		PROFILE_FRAME();
+		if (!Profiler::get().writeChromeTrace(opts.tracePath)) return 1;
+	}
+
+	if (opts.jsonPath == "-") {
+		cout << sim.getTimingJson();
+	}
+	else if (!opts.jsonPath.empty()) {
+		std::ofstream out(opts.jsonPath.c_str());
+		if (!out) {
+			cout << "Can't write: " << opts.jsonPath << endl;
+			return 1;
+		}
+		out << sim.getTimingJson();
+	}
+	return diverged ? 2 : 0;
+}
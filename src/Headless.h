@@ -0,0 +1,47 @@
+#pragma once
+#include "ofMain.h"
+
+//  Runs the Simulation without a window or GL context, for benchmarking
+//  and regression runs on machines without a GPU.
+//
+//    CountryRoads --headless [--steps N] [--dt sec] [--json file]
+//                 [--terrain file.obj] [--ship file.obj] [--no-thrust] [--no-harvest]
+//                 [--trace file] [--replay file] [--serial-stages]
+//
+//  Loads the terrain and ship OBJs from the data folder, builds the octree
+//  and SDF, runs N fixed steps with the thruster and harvest emitters
+//  running, and prints per-stage timings.  With --json the timings are also
+//  written as JSON ("-" for stdout).  "--terrain synthetic" uses generated
+//  terrain (TerrainGen.h) instead of the OBJ.  --trace saves the profiler
+//  ring buffer (the last steps) as a Chrome trace, in builds with
+//  COUNTRYROADS_PROFILE.  --serial-stages runs the stages of each step one
+//  after the other instead of on the job pool, for comparison.
+//
+//  --replay flies a recorded run (InputRecorder.h, "--record file" in the
+//  app) instead of leaving the thruster on: the recorded controls are
+//  applied at their steps, with the recording's step size, for its length
+//  unless --steps is given.  At the end the trajectory is checked against
+//  the recording and the exit code is 2 if it differs, so the same flight
+//  can serve as a timing benchmark and a regression check.
+//
+struct HeadlessOptions {
+	int steps = 0;      // 0: 1200, or the length of the replayed recording
+	float dt = 1.0 / 120;
+	string terrainPath = "cornMoon1/cornMoon1.obj";
+	string shipPath = "Tractor/Tractor.obj";
+	string jsonPath;
+	string tracePath;
+	string replayPath;
+	bool thrust = true;
+	bool harvest = true;
+	bool parallelStages = true;
+};
+
+// returns true if the command line asks for a headless run.  ok is set to
+// false (and the problem printed) if the other arguments are bad.
+//
+bool parseHeadlessOptions(int argc, char *argv[], HeadlessOptions &opts, bool &ok);
+
+// returns the process exit code
+//
+int runHeadless(const HeadlessOptions &opts);
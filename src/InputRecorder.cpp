@@ -0,0 +1,111 @@
+
+#include <cmath>
+#include <fstream>
+#include "InputRecorder.h"
+
+static_assert(sizeof(ControlEvent) == 12, "ControlEvent is written to disk as is");
+
+void InputRecorder::clear() {
+	events.clear();
+	steps = 0;
+	hash = 0;
+	cursor = 0;
+}
+
+// key repeat sends the same control over and over, only the first counts
+//
+void InputRecorder::record(uint32_t step, Control control, float value) {
+	if (!events.empty() && control != CONTROL_RESET) {
+		const ControlEvent &last = events.back();
+		if (last.control == control && last.value == value) return;
+	}
+	ControlEvent e;
+	e.step = step;
+	e.control = (uint8_t)control;
+	e.pad[0] = e.pad[1] = e.pad[2] = 0;
+	e.value = value;
+	events.push_back(e);
+}
+
+int InputRecorder::replay(Simulation &sim, uint32_t step) {
+	int n = 0;
+	while (cursor < events.size() && events[cursor].step <= step) {
+		sim.applyControl(events[cursor++]);
+		n++;
+	}
+	return n;
+}
+
+bool InputRecorder::save(const string &path) const {
+	std::ofstream out(path.c_str(), std::ios::binary);
+	if (!out) {
+		cout << "Can't write recording: " << path << endl;
+		return false;
+	}
+	uint32_t version = VERSION, n = events.size();
+	out.write("CRIN", 4);
+	out.write((const char *)&version, sizeof(version));
+	out.write((const char *)&dt, sizeof(dt));
+	out.write((const char *)&steps, sizeof(steps));
+	out.write((const char *)&hash, sizeof(hash));
+	out.write((const char *)&n, sizeof(n));
+	out.write((const char *)events.data(), n * sizeof(ControlEvent));
+	return (bool)out;
+}
+
+bool InputRecorder::load(const string &path) {
+	clear();
+	std::ifstream in(path.c_str(), std::ios::binary);
+	if (!in) {
+		cout << "Can't read recording: " << path << endl;
+		return false;
+	}
+
+	char magic[4];
+	uint32_t version, n;
+	in.read(magic, 4);
+	in.read((char *)&version, sizeof(version));
+	if (!in || memcmp(magic, "CRIN", 4) != 0 || version != VERSION) {
+		cout << "Not a recording (or a different version): " << path << endl;
+		return false;
+	}
+	in.read((char *)&dt, sizeof(dt));
+	in.read((char *)&steps, sizeof(steps));
+	in.read((char *)&hash, sizeof(hash));
+	in.read((char *)&n, sizeof(n));
+	if (!in) {
+		cout << "Truncated recording: " << path << endl;
+		return false;
+	}
+
+	// the step is handed to the clock and the sim thread as is
+	//
+	if (!std::isfinite(dt) || dt <= 0) {
+		cout << "Bad step " << dt << " in recording: " << path << endl;
+		clear();
+		return false;
+	}
+
+	// the count comes from the file, so read in chunks rather than trust it
+	//
+	const uint32_t chunk = 4096;
+	for (uint32_t i = 0; i < n; i += chunk) {
+		uint32_t m = std::min(chunk, n - i);
+		events.resize(i + m);
+		in.read((char *)&events[i], m * sizeof(ControlEvent));
+		if (!in) {
+			cout << "Truncated recording: " << path << endl;
+			clear();
+			return false;
+		}
+	}
+	for (int i = 0; i < events.size(); i++) {
+		bool ordered = i == 0 || events[i].step >= events[i - 1].step;
+		if (!ordered || events[i].control >= NUM_CONTROLS) {
+			cout << "Bad event " << i << " in recording: " << path << endl;
+			clear();
+			return false;
+		}
+	}
+	return true;
+}
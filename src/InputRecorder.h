@@ -0,0 +1,45 @@
+#pragma once
+#include "ofMain.h"
+#include "Simulation.h"
+
+//  Records pilot controls keyed by simulation step and plays them back.
+//
+//  The simulation is deterministic given its controls (fixed steps and
+//  counter based random numbers), so replaying a recording with the same
+//  terrain and step size reproduces the flight exactly.  The recording
+//  keeps the step count and the trajectory hash at the end of the run, so
+//  a replay can check it really did.
+//
+//  File layout, little endian:
+//
+//    "CRIN"  uint32 version  float dt  uint32 steps  uint64 hash  uint32 n
+//    n x { uint32 step  uint8 control  3 bytes pad  float value }
+//
+class InputRecorder {
+public:
+	static const uint32_t VERSION = 1;
+
+	void clear();
+
+	// add an event for step (events must come in step order).  A repeat of
+	// the last event is dropped, it wouldn't change anything.
+	//
+	void record(uint32_t step, Control control, float value);
+
+	// apply the events due before step, returns how many
+	//
+	int replay(Simulation &sim, uint32_t step);
+	void rewind() { cursor = 0; }
+	bool isFinished() const { return cursor >= events.size(); }
+
+	bool save(const string &path) const;
+	bool load(const string &path);
+
+	vector<ControlEvent> events;
+	float dt = 1.0 / 120;
+	uint32_t steps = 0;         // length of the recorded run
+	uint64_t hash = 0;          // Simulation::trajectoryHash at the end of it
+
+private:
+	int cursor = 0;
+};
@@ -0,0 +1,167 @@
+
+#include "JobPool.h"
+
+// index of the calling thread's worker queue (-1 if not a worker),
+// and the pool it belongs to
+//
+static thread_local int workerIndex = -1;
+static thread_local const JobPool *workerPool = nullptr;
+
+JobPool::JobPool(int numThreads) : pending(0), done(false) {
+	if (numThreads < 0) {
+		numThreads = (int)std::thread::hardware_concurrency() - 1;
+		if (numThreads < 0) numThreads = 0;
+	}
+	for (int i = 0; i <= numThreads; i++)
+		queues.push_back(std::unique_ptr<Queue>(new Queue()));
+	for (int i = 0; i < numThreads; i++)
+		threads.push_back(std::thread(&JobPool::workerLoop, this, i));
+}
+
+JobPool::~JobPool() {
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		done = true;
+	}
+	wake.notify_all();
+	for (std::thread &t : threads)
+		t.join();
+}
+
+int JobPool::queueIndex() const {
+	if (workerPool == this) return workerIndex;
+	return (int)threads.size();    // shared queue
+}
+
+void JobPool::Queue::pushBack(Job &&job) {
+	if (count == ring.size()) {
+		// unroll into a ring twice the size
+		//
+		std::vector<Job> bigger(std::max<size_t>(16, ring.size() * 2));
+		for (size_t i = 0; i < count; i++)
+			bigger[i] = std::move(ring[(head + i) & (ring.size() - 1)]);
+		ring.swap(bigger);
+		head = 0;
+	}
+	ring[(head + count) & (ring.size() - 1)] = std::move(job);
+	count++;
+}
+
+bool JobPool::Queue::popBack(Job &job) {
+	if (count == 0) return false;
+	count--;
+	Job &slot = ring[(head + count) & (ring.size() - 1)];
+	job = std::move(slot);
+	slot = nullptr;
+	return true;
+}
+
+bool JobPool::Queue::popFront(Job &job) {
+	if (count == 0) return false;
+	Job &slot = ring[head];
+	job = std::move(slot);
+	slot = nullptr;
+	head = (head + 1) & (ring.size() - 1);
+	count--;
+	return true;
+}
+
+void JobPool::submit(Job job) {
+	Queue &q = *queues[queueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(q.mutex);
+		q.pushBack(std::move(job));
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		pending++;
+	}
+	wake.notify_one();
+}
+
+// newest job from our own queue
+//
+bool JobPool::pop(int index, Job & job) {
+	Queue &q = *queues[index];
+	std::lock_guard<std::mutex> lock(q.mutex);
+	return q.popBack(job);
+}
+
+// oldest job from anyone else's queue
+//
+bool JobPool::steal(int index, Job & job) {
+	int n = (int)queues.size();
+	for (int k = 1; k <= n; k++) {
+		Queue &q = *queues[(index + k) % n];
+		std::lock_guard<std::mutex> lock(q.mutex);
+		if (q.popFront(job)) return true;
+	}
+	return false;
+}
+
+bool JobPool::runOne() {
+	if (pending == 0) return false;
+	int index = queueIndex();
+	Job job;
+	if (!pop(index, job) && !steal(index, job))
+		return false;
+	pending--;
+	job();
+	return true;
+}
+
+void JobPool::workerLoop(int index) {
+	workerIndex = index;
+	workerPool = this;
+	while (true) {
+		if (runOne()) continue;
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this] { return done || pending > 0; });
+		if (done) return;
+	}
+}
+
+void JobPool::parallelFor(int begin, int end, int chunkSize, const std::function<void(int, int)> & fn) {
+	if (end <= begin) return;
+	if (chunkSize < 1) chunkSize = 1;
+	int numChunks = (end - begin + chunkSize - 1) / chunkSize;
+
+	// small ranges or no workers: just do it here
+	//
+	if (numChunks == 1 || threads.empty()) {
+		for (int b = begin; b < end; b += chunkSize)
+			fn(b, std::min(b + chunkSize, end));
+		return;
+	}
+
+	// the jobs only capture the range and chunk number, small enough for
+	// std::function to keep without allocating
+	//
+	struct Range {
+		const std::function<void(int, int)> *fn;
+		int begin, end, chunkSize;
+		std::atomic<int> remaining;
+		void run(int c) {
+			int b = begin + c * chunkSize;
+			(*fn)(b, std::min(b + chunkSize, end));
+			remaining--;
+		}
+	};
+	Range range;
+	range.fn = &fn;
+	range.begin = begin;
+	range.end = end;
+	range.chunkSize = chunkSize;
+	range.remaining = numChunks;
+	Range *r = &range;
+	for (int c = 1; c < numChunks; c++)
+		submit([r, c] { r->run(c); });
+
+	// first chunk on this thread, then help until every chunk is done
+	//
+	range.run(0);
+	while (range.remaining > 0) {
+		if (!runOne()) std::this_thread::yield();
+	}
+}
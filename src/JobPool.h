@@ -0,0 +1,67 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//  Work stealing thread pool.
+//
+//  Every worker has its own job queue.  A worker takes jobs from the back of
+//  its own queue and, when that is empty, steals from the front of the
+//  others.  Jobs submitted from a thread that is not a worker go to a shared
+//  queue that everyone steals from.
+//
+//  A thread waiting on jobs (parallelFor) runs pending jobs itself instead
+//  of blocking, so jobs can submit and wait on more jobs.
+//
+class JobPool {
+public:
+	typedef std::function<void()> Job;
+
+	JobPool(int numThreads = -1);    // -1 = one per core, less the calling thread
+	~JobPool();
+
+	int getNumThreads() const { return (int)threads.size(); }
+	void submit(Job job);
+
+	// run one pending job on the calling thread, false if there was none
+	//
+	bool runOne();
+
+	// call fn(begin, end) for each chunk of [begin, end), chunkSize at a time,
+	// and return when all of them are done.  The chunks only depend on the
+	// arguments, not on the number of threads.
+	//
+	void parallelFor(int begin, int end, int chunkSize, const std::function<void(int, int)> & fn);
+
+private:
+	// ring buffer of jobs that only grows, so a busy queue doesn't allocate
+	// once it has reached its size.  Lock mutex around the calls.
+	//
+	struct Queue {
+		std::mutex mutex;
+		std::vector<Job> ring;
+		size_t head = 0;
+		size_t count = 0;
+
+		void pushBack(Job &&job);
+		bool popBack(Job &job);
+		bool popFront(Job &job);
+	};
+
+	void workerLoop(int index);
+	bool pop(int index, Job & job);
+	bool steal(int index, Job & job);
+	int queueIndex() const;
+
+	std::vector<std::unique_ptr<Queue> > queues;   // workers, then the shared queue
+	std::vector<std::thread> threads;
+	std::atomic<int> pending;
+	std::atomic<bool> done;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+};
@@ -0,0 +1,210 @@
+
+#include <cfloat>
+#include "OcclusionCuller.h"
+#include "Profiler.h"
+
+void OcclusionCuller::setup(int width, int height) {
+	this->width = (width + 3) & ~3;
+	this->height = height;
+	depth.assign(this->width * this->height, 1.0f);
+}
+
+void OcclusionCuller::setOccluders(const TerrainPatches &terrain, int cells, float bias) {
+	PROFILE_SCOPE("OcclusionCuller::setOccluders");
+	const int sub = 4;                      // height samples per cell and axis
+	const Vector3 &min = terrain.getBounds().parameters[0];
+	const Vector3 &max = terrain.getBounds().parameters[1];
+	float cellX = (max.x() - min.x()) / cells;
+	float cellZ = (max.z() - min.z()) / cells;
+
+	// every sample height in one batched query
+	//
+	int n = cells * sub + 1;
+	vector<ofVec2f> xz(n * n);
+	vector<float> samples(n * n);
+	for (int k = 0; k < n; k++) {
+		for (int i = 0; i < n; i++) {
+			xz[k * n + i] = ofVec2f(min.x() + i * cellX / sub, min.z() + k * cellZ / sub);
+		}
+	}
+	terrain.columnHeights(xz.data(), n * n, samples.data());
+
+	// each vertex at the lowest sample of the cells around it, so the
+	// triangles between vertices stay under the surface.  -FLT_MAX marks
+	// a vertex next to a hole in the terrain.
+	//
+	int m = cells + 1;
+	vector<float> heights(m * m);
+	for (int k = 0; k < m; k++) {
+		for (int i = 0; i < m; i++) {
+			float h = FLT_MAX;
+			for (int sk = std::max(0, (k - 1) * sub); sk <= std::min(n - 1, (k + 1) * sub); sk++) {
+				for (int si = std::max(0, (i - 1) * sub); si <= std::min(n - 1, (i + 1) * sub); si++) {
+					h = std::min(h, samples[sk * n + si]);
+				}
+			}
+			heights[k * m + i] = h == -FLT_MAX ? h : h - bias;
+		}
+	}
+
+	occluders.clear();
+	for (int k = 0; k < cells; k++) {
+		for (int i = 0; i < cells; i++) {
+			int v[4] = { k * m + i, k * m + i + 1, (k + 1) * m + i + 1, (k + 1) * m + i };
+			ofVec3f p[4];
+			bool hole = false;
+			for (int j = 0; j < 4; j++) {
+				int vi = v[j] % m, vk = v[j] / m;
+				p[j] = ofVec3f(min.x() + vi * cellX, heights[v[j]], min.z() + vk * cellZ);
+				hole |= heights[v[j]] == -FLT_MAX;
+			}
+			if (hole) continue;
+			occluders.push_back(p[0]);
+			occluders.push_back(p[1]);
+			occluders.push_back(p[2]);
+			occluders.push_back(p[0]);
+			occluders.push_back(p[2]);
+			occluders.push_back(p[3]);
+		}
+	}
+}
+
+// to pixels; false when p is behind the near plane
+//
+bool OcclusionCuller::project(const ofVec3f &p, ScreenVertex &v) const {
+	glm::vec4 clip = viewProjection * glm::vec4(p.x, p.y, p.z, 1.0f);
+	if (clip.w < 1e-5f) return false;
+	float inv = 1 / clip.w;
+	v.x = (clip.x * inv * 0.5f + 0.5f) * width;
+	v.y = (0.5f - clip.y * inv * 0.5f) * height;
+	v.z = clip.z * inv;
+	return true;
+}
+
+void OcclusionCuller::begin(const glm::mat4 &viewProjection) {
+	PROFILE_SCOPE("OcclusionCuller::begin");
+	this->viewProjection = viewProjection;
+	std::fill(depth.begin(), depth.end(), 1.0f);
+	tested = 0;
+	culled = 0;
+	rasterized = 0;
+
+	// triangles crossing the near plane are left out, which only loses
+	// occlusion
+	//
+	for (int t = 0; t + 2 < occluders.size(); t += 3) {
+		ScreenVertex a, b, c;
+		if (!project(occluders[t], a) || !project(occluders[t + 1], b) || !project(occluders[t + 2], c))
+			continue;
+		rasterize(a, b, c);
+	}
+}
+
+// Edge functions at pixel centers, both windings.  Keeps the nearest depth
+// per pixel, depth is interpolated linearly in screen space (NDC z is).
+//
+void OcclusionCuller::rasterize(const ScreenVertex &a, const ScreenVertex &b0, const ScreenVertex &c0) {
+	float area = (b0.x - a.x) * (c0.y - a.y) - (b0.y - a.y) * (c0.x - a.x);
+	if (fabs(area) < 1e-6f) return;
+	const ScreenVertex &b = area > 0 ? b0 : c0;
+	const ScreenVertex &c = area > 0 ? c0 : b0;
+	area = fabs(area);
+
+	int x0 = std::max(0, (int)floor(std::min({ a.x, b.x, c.x })));
+	int x1 = std::min(width - 1, (int)ceil(std::max({ a.x, b.x, c.x })));
+	int y0 = std::max(0, (int)floor(std::min({ a.y, b.y, c.y })));
+	int y1 = std::min(height - 1, (int)ceil(std::max({ a.y, b.y, c.y })));
+	if (x0 > x1 || y0 > y1) return;
+	x0 &= ~3;
+	rasterized++;
+
+	// w = A x + B y + C for the edge opposite each vertex, normalized so
+	// the three add up to 1 inside the triangle
+	//
+	float inv = 1 / area;
+	float A0 = (b.y - c.y) * inv, B0 = (c.x - b.x) * inv, C0 = (b.x * c.y - b.y * c.x) * inv;
+	float A1 = (c.y - a.y) * inv, B1 = (a.x - c.x) * inv, C1 = (c.x * a.y - c.y * a.x) * inv;
+	float A2 = (a.y - b.y) * inv, B2 = (b.x - a.x) * inv, C2 = (a.x * b.y - a.y * b.x) * inv;
+
+	for (int y = y0; y <= y1; y++) {
+		float py = y + 0.5f;
+		float *row = &depth[y * width];
+#ifdef VECTOR3_SSE
+		__m128 px = _mm_add_ps(_mm_set1_ps(x0 + 0.5f), _mm_set_ps(3, 2, 1, 0));
+		__m128 w0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A0), px), _mm_set1_ps(B0 * py + C0));
+		__m128 w1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A1), px), _mm_set1_ps(B1 * py + C1));
+		__m128 w2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A2), px), _mm_set1_ps(B2 * py + C2));
+		__m128 step0 = _mm_set1_ps(A0 * 4), step1 = _mm_set1_ps(A1 * 4), step2 = _mm_set1_ps(A2 * 4);
+		__m128 za = _mm_set1_ps(a.z), zb = _mm_set1_ps(b.z), zc = _mm_set1_ps(c.z);
+		__m128 zero = _mm_setzero_ps();
+		for (int x = x0; x <= x1; x += 4) {
+			__m128 in = _mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_and_ps(_mm_cmpge_ps(w1, zero), _mm_cmpge_ps(w2, zero)));
+			if (_mm_movemask_ps(in)) {
+				__m128 z = _mm_add_ps(_mm_mul_ps(w0, za), _mm_add_ps(_mm_mul_ps(w1, zb), _mm_mul_ps(w2, zc)));
+				__m128 old = _mm_loadu_ps(row + x);
+				__m128 nearest = _mm_min_ps(old, z);
+				_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(in, nearest), _mm_andnot_ps(in, old)));
+			}
+			w0 = _mm_add_ps(w0, step0);
+			w1 = _mm_add_ps(w1, step1);
+			w2 = _mm_add_ps(w2, step2);
+		}
+#else
+		for (int x = x0; x <= x1; x++) {
+			float px = x + 0.5f;
+			float w0 = A0 * px + B0 * py + C0;
+			float w1 = A1 * px + B1 * py + C1;
+			float w2 = A2 * px + B2 * py + C2;
+			if (w0 < 0 || w1 < 0 || w2 < 0) continue;
+			float z = w0 * a.z + w1 * b.z + w2 * c.z;
+			if (z < row[x]) row[x] = z;
+		}
+#endif
+	}
+}
+
+bool OcclusionCuller::isVisible(const Box &box) const {
+	tested++;
+	const Vector3 &lo = box.parameters[0];
+	const Vector3 &hi = box.parameters[1];
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, minZ = FLT_MAX;
+	for (int i = 0; i < 8; i++) {
+		ofVec3f p((i & 1) ? hi.x() : lo.x(), (i & 2) ? hi.y() : lo.y(), (i & 4) ? hi.z() : lo.z());
+		ScreenVertex v;
+		if (!project(p, v)) return true;
+		minX = std::min(minX, v.x);
+		maxX = std::max(maxX, v.x);
+		minY = std::min(minY, v.y);
+		maxY = std::max(maxY, v.y);
+		minZ = std::min(minZ, v.z);
+	}
+
+	// off the screen or past the far plane
+	//
+	if (maxX < 0 || minX >= width || maxY < 0 || minY >= height || minZ > 1) {
+		culled++;
+		return false;
+	}
+
+	// visible if any covered pixel has no occluder in front of the box
+	//
+	int x0 = std::max(0, (int)floor(minX)) & ~3;
+	int x1 = std::min(width - 1, (int)ceil(maxX));
+	int y0 = std::max(0, (int)floor(minY));
+	int y1 = std::min(height - 1, (int)ceil(maxY));
+	for (int y = y0; y <= y1; y++) {
+		const float *row = &depth[y * width];
+#ifdef VECTOR3_SSE
+		__m128 z = _mm_set1_ps(minZ);
+		for (int x = x0; x <= x1; x += 4) {
+			if (_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(row + x), z))) return true;
+		}
+#else
+		for (int x = x0; x <= x1; x++) {
+			if (row[x] >= minZ) return true;
+		}
+#endif
+	}
+	culled++;
+	return false;
+}
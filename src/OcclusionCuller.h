@@ -0,0 +1,67 @@
+#pragma once
+#include "ofMain.h"
+#include "box.h"
+#include "TerrainPatches.h"
+
+//  Software occlusion culling on the CPU.
+//
+//  A coarse version of the terrain is rasterized into a small depth buffer
+//  from the camera every frame, then isVisible() tests bounding boxes
+//  against it: a box is hidden when every pixel its screen rectangle covers
+//  already has an occluder in front of the box's nearest point.  The
+//  rasterizer and the test work on 4 pixels at a time with SSE (plain
+//  loops without it).
+//
+//  The occluders are built under the real surface, so the culler can only
+//  be wrong in the safe direction and draws a little too much.  Boxes that
+//  reach behind the near plane always count as visible, boxes entirely off
+//  the screen never do.
+//
+//  No GL involved; the depth buffer can be checked headless.
+//
+class OcclusionCuller {
+public:
+	// depth buffer size, width is rounded up to a multiple of 4
+	//
+	void setup(int width = 160, int height = 120);
+
+	// coarse terrain: cells x cells quads over the terrain's xz extent.
+	// Each vertex takes the lowest height within a cell of it, less bias.
+	//
+	void setOccluders(const TerrainPatches &terrain, int cells = 24, float bias = 0.5);
+
+	// clear the buffer and rasterize the occluders with viewProjection
+	// (projection * view, OpenGL clip space)
+	//
+	void begin(const glm::mat4 &viewProjection);
+
+	bool isVisible(const Box &box) const;
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	int getNumOccluders() const { return (int)occluders.size() / 3; }
+	int getNumRasterized() const { return rasterized; }
+
+	// NDC depth of the nearest occluder per pixel, rows top to bottom, 1 = empty
+	//
+	const vector<float> & getDepth() const { return depth; }
+
+	// boxes tested and culled since begin()
+	//
+	mutable int tested = 0;
+	mutable int culled = 0;
+
+private:
+	struct ScreenVertex {
+		float x, y, z;
+	};
+	bool project(const ofVec3f &p, ScreenVertex &v) const;
+	void rasterize(const ScreenVertex &a, const ScreenVertex &b, const ScreenVertex &c);
+
+	glm::mat4 viewProjection;
+	vector<ofVec3f> occluders;    // 3 per triangle
+	vector<float> depth;
+	int width = 0;
+	int height = 0;
+	int rasterized = 0;
+};
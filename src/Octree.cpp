@@ -2,7 +2,11 @@
 //
 
 
+#include <cfloat>
 #include "Octree.h"
+#include "Profiler.h"
+#include "AllocTracker.h"
+#include "FrameArena.h"
  
 
 // draw Octree (recursively)
@@ -28,6 +32,18 @@ void Octree::drawLeafNodes(TreeNode & node) {
    }
 }
 
+// collect pointers to all leaf nodes below node
+//
+void Octree::getLeafNodes(const TreeNode & node, vector<const TreeNode *> & leaves) const {
+   if (node.children.size() == 0) {
+      leaves.push_back(&node);
+      return;
+   }
+   for (int i = 0; i < node.children.size(); i++) {
+      getLeafNodes(node.children[i], leaves);
+   }
+}
+
 
 //draw a box from a "Box" class  
 //
@@ -35,8 +51,7 @@ void Octree::drawBox(const Box &box) {
 	Vector3 min = box.parameters[0];
 	Vector3 max = box.parameters[1];
 	Vector3 size = max - min;
-	Vector3 center = size / 2 + min;
-	ofVec3f p = ofVec3f(center.x(), center.y(), center.z());
+	ofVec3f p = (size / 2 + min).as<ofVec3f>();
 	float w = size.x();
 	float h = size.y();
 	float d = size.z();
@@ -64,7 +79,7 @@ Box Octree::meshBounds(const ofMesh & mesh) {
 	}
 	cout << "vertices: " << n << endl;
 //	cout << "min: " << min << "max: " << max << endl;
-	return Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+	return Box(min, max);
 }
 
 // getMeshPointsInBox:  return an array of indices to points in mesh that are contained 
@@ -75,8 +90,7 @@ int Octree::getMeshPointsInBox(const ofMesh & mesh, const vector<int>& points,
 {
    int count = 0;
    for (int i = 0; i < points.size(); i++) {
-      ofVec3f v = mesh.getVertex(points[i]);
-      if (box.inside(Vector3(v.x, v.y, v.z))) {
+      if (box.inside(mesh.getVertex(points[i]))) {
          count++;
          pointsRtn.push_back(points[i]);
       }
@@ -88,7 +102,7 @@ int Octree::getMeshPointsInBox(const ofMesh & mesh, const vector<int>& points,
 
 //  Subdivide a Box into eight(8) equal size boxes, return them in boxList;
 //
-void Octree::subDivideBox8(const Box &box, vector<Box> & boxList) {
+void Octree::subDivideBox8(const Box &box, Box boxList[8]) {
 	Vector3 min = box.parameters[0];
 	Vector3 max = box.parameters[1];
 	Vector3 size = max - min;
@@ -100,25 +114,21 @@ void Octree::subDivideBox8(const Box &box, vector<Box> & boxList) {
 
 	//  generate ground floor
 	//
-	Box b[8];
+	Box *b = boxList;
 	b[0] = Box(min, center);
 	b[1] = Box(b[0].min() + Vector3(xdist, 0, 0), b[0].max() + Vector3(xdist, 0, 0));
 	b[2] = Box(b[1].min() + Vector3(0, 0, zdist), b[1].max() + Vector3(0, 0, zdist));
 	b[3] = Box(b[2].min() + Vector3(-xdist, 0, 0), b[2].max() + Vector3(-xdist, 0, 0));
 
-	boxList.clear();
-	for (int i = 0; i < 4; i++)
-		boxList.push_back(b[i]);
-
 	// generate second story
 	//
-	for (int i = 4; i < 8; i++) {
+	for (int i = 4; i < 8; i++)
 		b[i] = Box(b[i - 4].min() + h, b[i - 4].max() + h);
-		boxList.push_back(b[i]);
-	}
 }
 
 void Octree::create(const ofMesh & geo, int numLevels) {
+	PROFILE_SCOPE("Octree::create");
+	ALLOC_TAG(ALLOC_OCTREE);
 	// initialize octree structure
 	//
    int level = 1;
@@ -135,17 +145,16 @@ void Octree::create(const ofMesh & geo, int numLevels) {
 void Octree::subdivide(const ofMesh & mesh, TreeNode & node, int numLevels, int level) {
    if (level >= numLevels)
       return;
-   vector<Box> childrenBoxes;
+   Box childrenBoxes[8];
    subDivideBox8(node.box, childrenBoxes);
-   vector<TreeNode> children;
 
    int count;
-   for (Box c : childrenBoxes) {
+   for (const Box &c : childrenBoxes) {
       TreeNode child;
       child.box = c;
       count = getMeshPointsInBox(mesh, node.points, child.box, child.points);
       if (count > 0) {
-         node.children.push_back(child);
+         node.children.push_back(std::move(child));
       }
       if (count > 1) {
          subdivide(mesh, node.children.back(), numLevels, level + 1);
@@ -155,10 +164,18 @@ void Octree::subdivide(const ofMesh & mesh, TreeNode & node, int numLevels, int
 
 // Ray Intersection
 bool Octree::intersect(const Ray &ray, const TreeNode & node, TreeNode & nodeRtn) {
+   const TreeNode *leaf;
+   if (!intersect(ray, node, leaf))
+      return false;
+   nodeRtn = *leaf;
+   return true;
+}
+
+bool Octree::intersect(const Ray &ray, const TreeNode & node, const TreeNode * & nodeRtn) const {
    if (node.box.intersect(ray, -1000, 1000)) {
       if (node.children.size() == 0)
       {
-         nodeRtn = node;
+         nodeRtn = &node;
          return true;
       }
 
@@ -173,9 +190,17 @@ bool Octree::intersect(const Ray &ray, const TreeNode & node, TreeNode & nodeRtn
 
 // Check collision. If point is inside a leaf node, there is collision
 bool Octree::intersect(const ofVec3f &p, const TreeNode & node, TreeNode & nodeRtn) {
-   if (node.box.inside(Vector3(p.x, p.y, p.z))) {
+   const TreeNode *leaf;
+   if (!intersect(p, node, leaf))
+      return false;
+   nodeRtn = *leaf;
+   return true;
+}
+
+bool Octree::intersect(const ofVec3f &p, const TreeNode & node, const TreeNode * & nodeRtn) const {
+   if (node.box.inside(p)) {
       if (node.children.size() == 0) {
-         nodeRtn = node;
+         nodeRtn = &node;
          return true;
       }
 
@@ -187,5 +212,57 @@ bool Octree::intersect(const ofVec3f &p, const TreeNode & node, TreeNode & nodeR
    return false;
 }
 
+void Octree::columnHeights(const ofVec2f *xz, int n, float *heightRtn) const {
+   FrameArena &arena = FrameArena::local();
+   ArenaScope scope(arena);
+   int *queries = arena.allocate<int>(n);
+   for (int i = 0; i < n; i++) {
+      queries[i] = i;
+      heightRtn[i] = -FLT_MAX;
+   }
+   columnHeights(root, xz, queries, n, heightRtn);
+}
 
+// The queries go down the tree together, every node only gets the ones
+// inside its xz extent that have no height yet.  The upper story of a node
+// is visited first (subDivideBox8 puts it last), so the first leaf a query
+// reaches is the highest one over its column.
+//
+void Octree::columnHeights(const TreeNode & node, const ofVec2f *xz, const int *queries, int n,
+   float *heightRtn) const
+{
+   if (node.children.size() == 0) {
+      for (int i = 0; i < n; i++) {
+         int q = queries[i];
+         float best = FLT_MAX;
+         for (int p = 0; p < node.points.size(); p++) {
+            glm::vec3 v = mesh.getVertex(node.points[p]);
+            float dx = v.x - xz[q].x;
+            float dz = v.z - xz[q].y;
+            float d = dx * dx + dz * dz;
+            if (d < best || (d == best && v.y > heightRtn[q])) {
+               best = d;
+               heightRtn[q] = v.y;
+            }
+         }
+      }
+      return;
+   }
 
+   FrameArena &arena = FrameArena::local();
+   ArenaScope scope(arena);
+   int *inside = arena.allocate<int>(n);
+   for (int c = (int)node.children.size() - 1; c >= 0; c--) {
+      const TreeNode &child = node.children[c];
+      const Vector3 &min = child.box.parameters[0];
+      const Vector3 &max = child.box.parameters[1];
+      int count = 0;
+      for (int i = 0; i < n; i++) {
+         int q = queries[i];
+         const ofVec2f &p = xz[q];
+         if (heightRtn[q] == -FLT_MAX && p.x >= min.x() && p.x <= max.x() && p.y >= min.z() && p.y <= max.z())
+            inside[count++] = q;
+      }
+      if (count > 0) columnHeights(child, xz, inside, count, heightRtn);
+   }
+}
@@ -18,16 +18,33 @@ public:
 	void subdivide(const ofMesh & mesh, TreeNode & node, int numLevels, int level);
 	bool intersect(const Ray &, const TreeNode & node, TreeNode & nodeRtn);
    bool intersect(const ofVec3f &, const TreeNode & node, TreeNode & nodeRtn);
+
+   // same, returning the leaf instead of a copy of it (which copies its
+   // point list), for queries every frame
+   //
+   bool intersect(const Ray &, const TreeNode & node, const TreeNode * & nodeRtn) const;
+   bool intersect(const ofVec3f &, const TreeNode & node, const TreeNode * & nodeRtn) const;
 	void draw(TreeNode & node, int numLevels, int level, vector<ofColor> colors);
 	void draw(int numLevels, int level, vector<ofColor> colors) {
 		draw(root, numLevels, level, colors);
 	}
 	void drawLeafNodes(TreeNode & node);
+
+	// Batched downward height query: for each (x, z), the height of the mesh
+	// vertex nearest to the vertical line through it in the highest leaf
+	// the line passes through.  -FLT_MAX where no leaf covers the point.
+	//
+	void columnHeights(const ofVec2f *xz, int n, float *heightRtn) const;
+	void getLeafNodes(const TreeNode & node, vector<const TreeNode *> & leaves) const;
 	static void drawBox(const Box &box);
 	static Box meshBounds(const ofMesh &);
 	int getMeshPointsInBox(const ofMesh &mesh, const vector<int> & points, Box & box, vector<int> & pointsRtn);
-	void subDivideBox8(const Box &b, vector<Box> & boxList);
+	void subDivideBox8(const Box &b, Box boxList[8]);
 
 	ofMesh mesh;
 	TreeNode root;
+
+private:
+	void columnHeights(const TreeNode & node, const ofVec2f *xz, const int *queries, int n,
+		float *heightRtn) const;
 };
\ No newline at end of file
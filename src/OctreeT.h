@@ -0,0 +1,289 @@
+#pragma once
+#include <cfloat>
+#include <limits>
+#include <type_traits>
+#include "ofMain.h"
+#include "box.h"
+#include "ray.h"
+#include "Octree.h"
+
+//  Compile-time configured variant of Octree.
+//
+//  IndexT        - unsigned type used for node and point indices (uint16_t, uint32_t)
+//  LeafCapacity  - a node with more points than this is subdivided
+//  MaxDepth      - maximum number of levels below the root
+//  Branching     - 8 (octree) or 4 (quadtree in xz, for height fields)
+//
+//  Nodes live in one flat array with the children of a node stored next to
+//  each other, and points are stored as one array of vertex indices that is
+//  partitioned so every node owns a contiguous range.  The query loops run over
+//  a fixed size stack and a fixed branching factor so they can be unrolled.
+//
+template <typename IndexT, int LeafCapacity, int MaxDepth, int Branching = 8>
+class OctreeT {
+   static_assert(std::is_unsigned<IndexT>::value, "IndexT must be an unsigned integer type");
+   static_assert(Branching == 8 || Branching == 4, "Branching must be 8 or 4");
+   static_assert(LeafCapacity > 0 && MaxDepth > 0, "bad LeafCapacity/MaxDepth");
+
+public:
+   static const int STACK_SIZE = MaxDepth * (Branching - 1) + 2;
+
+   struct Node {
+      Box box;
+      IndexT firstChild;      // 0 means leaf (root is never a child)
+      IndexT firstPoint;
+      IndexT numPoints;
+      unsigned char numChildren;
+   };
+
+   // build the tree from the vertices of mesh, returns false if the mesh
+   // or the resulting tree does not fit in IndexT
+   //
+   bool create(const ofMesh & mesh);
+   bool intersect(const Ray & ray, IndexT & leaf) const;
+   bool intersect(const ofVec3f & p, IndexT & leaf) const;
+
+   // batched downward height query like Octree::columnHeights: the height
+   // of the vertex nearest to the vertical line through each (x, z) in the
+   // deepest node over it, upper nodes first.  -FLT_MAX outside the root.
+   //
+   void columnHeights(const ofVec2f *xz, int n, float *heightRtn) const;
+
+   const Node & getNode(IndexT i) const { return nodes[i]; }
+   IndexT getPoint(IndexT i) const { return points[i]; }
+   int getNumNodes() const { return (int)nodes.size(); }
+   size_t getMemoryUsage() const { return nodes.size() * sizeof(Node) + points.size() * sizeof(IndexT); }
+
+   ofMesh mesh;
+
+private:
+   static int childIndex(const ofVec3f & v, const Vector3 & center) {
+      int i = (v.x > center.x()) | ((v.z > center.z()) << 1);
+      if (Branching == 8) i |= (v.y > center.y()) << 2;
+      return i;
+   }
+   static Box childBox(const Box & box, int i);
+   static Box bounds(const ofMesh & mesh);
+   void subdivide(IndexT n, int level);
+
+   vector<Node> nodes;
+   vector<IndexT> points;
+   vector<IndexT> scratch;
+};
+
+typedef OctreeT<uint32_t, 8, 12> TerrainOctree;   // large meshes, deep tree
+typedef OctreeT<uint16_t, 16, 4> PropOctree;      // small props, shallow tree
+typedef OctreeT<uint16_t, 8, 6, 4> PatchQuadtree; // terrain patches (TerrainPatches.h)
+
+
+template <typename IndexT, int LeafCapacity, int MaxDepth, int Branching>
+bool OctreeT<IndexT, LeafCapacity, MaxDepth, Branching>::create(const ofMesh & geo) {
+   const size_t maxIndex = std::numeric_limits<IndexT>::max();
+   nodes.clear();
+   points.clear();
+   if (geo.getNumVertices() == 0 || geo.getNumVertices() > maxIndex) {
+      cout << "OctreeT: mesh with " << geo.getNumVertices() << " vertices does not fit index type" << endl;
+      return false;
+   }
+   mesh = geo;
+
+   int n = mesh.getNumVertices();
+   points.resize(n);
+   for (int i = 0; i < n; i++) points[i] = i;
+   scratch.resize(n);
+
+   Node root;
+   root.box = bounds(mesh);
+   root.firstChild = 0;
+   root.firstPoint = 0;
+   root.numPoints = n;
+   root.numChildren = 0;
+   nodes.push_back(root);
+
+   subdivide(0, 0);
+
+   if (nodes.size() > maxIndex) {
+      cout << "OctreeT: " << nodes.size() << " nodes do not fit index type" << endl;
+      nodes.clear();
+      points.clear();
+      return false;
+   }
+   return true;
+}
+
+// like Octree::meshBounds, without the report (a TerrainPatches makes
+// hundreds of these)
+//
+template <typename IndexT, int LeafCapacity, int MaxDepth, int Branching>
+Box OctreeT<IndexT, LeafCapacity, MaxDepth, Branching>::bounds(const ofMesh & mesh) {
+   glm::vec3 min = mesh.getVertex(0);
+   glm::vec3 max = min;
+   for (int i = 1; i < mesh.getNumVertices(); i++) {
+      min = glm::min(min, mesh.getVertex(i));
+      max = glm::max(max, mesh.getVertex(i));
+   }
+   return Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+}
+
+// Subdivide a Box into Branching equal boxes; bit 0 is x, bit 1 is z and
+// bit 2 is y.  With a branching of 4 the box keeps its full height.
+//
+template <typename IndexT, int LeafCapacity, int MaxDepth, int Branching>
+Box OctreeT<IndexT, LeafCapacity, MaxDepth, Branching>::childBox(const Box & box, int i) {
+   Vector3 min = box.parameters[0];
+   Vector3 max = box.parameters[1];
+   Vector3 center = (max - min) / 2 + min;
+   Vector3 lo = Vector3((i & 1) ? center.x() : min.x(),
+      (Branching == 8 && (i & 4)) ? center.y() : min.y(),
+      (i & 2) ? center.z() : min.z());
+   Vector3 hi = Vector3((i & 1) ? max.x() : center.x(),
+      (Branching == 8 && !(i & 4)) ? center.y() : max.y(),
+      (i & 2) ? max.z() : center.z());
+   return Box(lo, hi);
+}
+
+// split node n, partitioning its point range among the children with a
+// counting sort.  Children are appended next to each other.
+//
+template <typename IndexT, int LeafCapacity, int MaxDepth, int Branching>
+void OctreeT<IndexT, LeafCapacity, MaxDepth, Branching>::subdivide(IndexT n, int level) {
+   if (level >= MaxDepth || nodes[n].numPoints <= LeafCapacity)
+      return;
+
+   Box box = nodes[n].box;
+   Vector3 center = (box.parameters[1] - box.parameters[0]) / 2 + box.parameters[0];
+   IndexT first = nodes[n].firstPoint;
+   IndexT count = nodes[n].numPoints;
+
+   int counts[Branching] = { 0 };
+   for (IndexT i = 0; i < count; i++) {
+      counts[childIndex(mesh.getVertex(points[first + i]), center)]++;
+   }
+
+   int offsets[Branching];
+   int sum = 0;
+   for (int c = 0; c < Branching; c++) {
+      offsets[c] = sum;
+      sum += counts[c];
+   }
+   for (IndexT i = 0; i < count; i++) {
+      IndexT p = points[first + i];
+      scratch[offsets[childIndex(mesh.getVertex(p), center)]++] = p;
+   }
+   std::copy(scratch.begin(), scratch.begin() + count, points.begin() + first);
+
+   IndexT firstChild = (IndexT)nodes.size();
+   unsigned char numChildren = 0;
+   IndexT start = first;
+   for (int c = 0; c < Branching; c++) {
+      if (counts[c] == 0) continue;
+      Node child;
+      child.box = childBox(box, c);
+      child.firstChild = 0;
+      child.firstPoint = start;
+      child.numPoints = counts[c];
+      child.numChildren = 0;
+      nodes.push_back(child);
+      start += counts[c];
+      numChildren++;
+   }
+   nodes[n].firstChild = firstChild;
+   nodes[n].numChildren = numChildren;
+
+   for (int c = 0; c < numChildren; c++) {
+      subdivide(firstChild + c, level + 1);
+   }
+}
+
+// Ray Intersection, returns the first leaf hit in depth first order
+//
+template <typename IndexT, int LeafCapacity, int MaxDepth, int Branching>
+bool OctreeT<IndexT, LeafCapacity, MaxDepth, Branching>::intersect(const Ray & ray, IndexT & leaf) const {
+   if (nodes.empty()) return false;
+   IndexT stack[STACK_SIZE];
+   int top = 0;
+   stack[top++] = 0;
+   while (top > 0) {
+      const Node & node = nodes[stack[--top]];
+      if (!node.box.intersect(ray, -1000, 1000)) continue;
+      if (node.numChildren == 0) {
+         leaf = (IndexT)(&node - &nodes[0]);
+         return true;
+      }
+      // push in reverse so the first child is visited first
+      for (int c = Branching - 1; c >= 0; c--) {
+         if (c < node.numChildren) stack[top++] = node.firstChild + c;
+      }
+   }
+   return false;
+}
+
+// Point query.  If point is inside a leaf node, there is collision
+//
+template <typename IndexT, int LeafCapacity, int MaxDepth, int Branching>
+bool OctreeT<IndexT, LeafCapacity, MaxDepth, Branching>::intersect(const ofVec3f & p, IndexT & leaf) const {
+   if (nodes.empty()) return false;
+   Vector3 v = p;
+   IndexT stack[STACK_SIZE];
+   int top = 0;
+   stack[top++] = 0;
+   while (top > 0) {
+      const Node & node = nodes[stack[--top]];
+      if (!node.box.inside(v)) continue;
+      if (node.numChildren == 0) {
+         leaf = (IndexT)(&node - &nodes[0]);
+         return true;
+      }
+      for (int c = Branching - 1; c >= 0; c--) {
+         if (c < node.numChildren) stack[top++] = node.firstChild + c;
+      }
+   }
+   return false;
+}
+
+// One query at a time straight down the tree.  Children are stored in
+// ascending child index and the upper ones (bit 2) come last, so they are
+// tried first.  Where no child covers the column (its quadrant had no
+// points) the node's own point range is searched, which the flat layout
+// makes one contiguous loop.
+//
+template <typename IndexT, int LeafCapacity, int MaxDepth, int Branching>
+void OctreeT<IndexT, LeafCapacity, MaxDepth, Branching>::columnHeights(const ofVec2f *xz, int n,
+   float *heightRtn) const
+{
+   auto covers = [](const Node & node, const ofVec2f & p) {
+      const Vector3 & min = node.box.parameters[0];
+      const Vector3 & max = node.box.parameters[1];
+      return p.x >= min.x() && p.x <= max.x() && p.y >= min.z() && p.y <= max.z();
+   };
+   for (int q = 0; q < n; q++) {
+      const ofVec2f & p = xz[q];
+      heightRtn[q] = -FLT_MAX;
+      if (nodes.empty() || !covers(nodes[0], p)) continue;
+
+      const Node *node = &nodes[0];
+      while (node->numChildren > 0) {
+         const Node *next = NULL;
+         for (int c = Branching - 1; c >= 0; c--) {
+            if (c < node->numChildren && covers(nodes[node->firstChild + c], p)) {
+               next = &nodes[node->firstChild + c];
+               break;
+            }
+         }
+         if (next == NULL) break;
+         node = next;
+      }
+
+      float best = FLT_MAX;
+      for (int i = node->firstPoint; i < node->firstPoint + node->numPoints; i++) {
+         glm::vec3 v = mesh.getVertex(points[i]);
+         float dx = v.x - p.x;
+         float dz = v.z - p.y;
+         float d = dx * dx + dz * dz;
+         if (d < best || (d == best && v.y > heightRtn[q])) {
+            best = d;
+            heightRtn[q] = v.y;
+         }
+      }
+   }
+}
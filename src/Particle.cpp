@@ -15,7 +15,6 @@ Particle::Particle() {
    damping = .99;
    mass = 1;
    color = ofColor::aquamarine;
-   oldTime = ofGetElapsedTimeMillis();
 }
 
 void Particle::draw() {
@@ -26,13 +25,7 @@ void Particle::draw() {
 
 // write your own integrator here.. (hint: it's only 3 lines of code)
 //
-void Particle::integrate() {
-   // interval for this step
-   //
-   float dt = 1 / ofGetFrameRate();
-   if (dt > 1)
-      dt = 0;
-
+void Particle::integrate(float dt) {
    // update position based on velocity
    position = position + (velocity * dt);
 
@@ -45,17 +38,17 @@ void Particle::integrate() {
 
    // add a little damping for good measure
    //
-   velocity *= damping;
+   velocity *= stepDamping(damping, dt);
 
    // clear forces on particle (they get re-added each step)
    //
    forces.set(0, 0, 0);
 }
 
-//  return age in seconds
+//  return age in seconds at simulation time "time"
 //
-float Particle::age() {
-   return (ofGetElapsedTimeMillis() - birthtime) / 1000.0;
+float Particle::age(float time) const {
+   return time - birthtime;
 }
 
 
@@ -4,6 +4,14 @@
 
 class ParticleForceField;
 
+// damping is the fraction of velocity kept per 1/60 sec (a frame at the
+// default frame rate, where it used to be applied), so drag doesn't depend
+// on the step size.  Velocity is scaled by this per step of dt sec.
+//
+inline float stepDamping(float damping, float dt) {
+   return pow(damping, dt * 60);
+}
+
 class Particle {
 public:
 	Particle();
@@ -12,16 +20,15 @@ public:
 	ofVec3f velocity;
 	ofVec3f acceleration;
 	ofVec3f forces;
-	float	damping;
+	float	damping;      // per 1/60 sec, see stepDamping
 	float   mass;
 	float   lifespan;
 	float   radius;
-	float   birthtime;
-	void    integrate();
+	float   birthtime;    // sec of simulation time
+	void    integrate(float dt);
 	void    draw();
-	float   age();        // sec
+	float   age(float time) const;        // sec
 	ofColor color;
-   float oldTime;
 };
 
 
@@ -2,6 +2,8 @@
 //  Kevin M. Smith - CS 134 SJSU
 
 #include "ParticleEmitter.h"
+#include "Profiler.h"
+#include "AllocTracker.h"
 
 ParticleEmitter::ParticleEmitter() {
 	sys = new ParticleSystem();
@@ -38,12 +40,15 @@ void ParticleEmitter::init() {
 	oneShot = false;
 	fired = false;
 	lastSpawned = 0;
+	time = 0;
 	radius = 1;
 	particleRadius = .1;
 	visible = true;
 	type = DirectionalEmitter;
 	groupSize = 1;
 	damping = .99;
+	rng = CounterRNG(0, 3);
+	spawnCount = 0;
 }
 
 
@@ -56,6 +61,7 @@ void ParticleEmitter::draw() {
 			break;
 		case SphereEmitter:
 		case RadialEmitter:
+		case DiscEmitter:
 			ofDrawSphere(position, radius/10);  // just draw a small sphere as a placeholder
 			break;
 		default:
@@ -66,24 +72,25 @@ void ParticleEmitter::draw() {
 }
 void ParticleEmitter::start() {
 	started = true;
-	lastSpawned = ofGetElapsedTimeMillis();
+	lastSpawned = time;
 }
 
 void ParticleEmitter::stop() {
 	started = false;
 	fired = false;
 }
-void ParticleEmitter::update() {
+// advance one simulation step of dt seconds, ending at "t"
+//
+void ParticleEmitter::update(float dt, float t) {
 
-	float time = ofGetElapsedTimeMillis();
+	time = t;
 
 	if (oneShot && started) {
 		if (!fired) {
 
 			// spawn a new particle(s)
 			//
-			for (int i = 0; i < groupSize; i++)
-				spawn(time);
+			spawn(time, groupSize);
 
 			lastSpawned = time;
 		}
@@ -91,57 +98,165 @@ void ParticleEmitter::update() {
 		stop();
 	}
 
-	else if (((time - lastSpawned) > (1000.0 / rate)) && started) {
+	else if (((time - lastSpawned) > (1.0 / rate)) && started) {
 
 		// spawn a new particle(s)
 		//
-		for (int i= 0; i < groupSize; i++)
-			spawn(time);
+		spawn(time, groupSize);
 	
 		lastSpawned = time;
 	}
 
-	sys->update();
+	sys->update(dt, time);
 }
 
-// spawn a single particle.  time is current time of birth
+// a burst every 1 / rate sec, each alive for up to the longest lifespan.
+// One more for the burst spawned before the step's expiry and one for a
+// particle outliving its lifespan until the next step.
 //
-void ParticleEmitter::spawn(float time) {
+int ParticleEmitter::getPeakCount() const {
+	if (oneShot) return groupSize;
+	float life = randomLife ? std::max(lifeMinMax.x, lifeMinMax.y) : lifespan;
+	return groupSize * ((int)ceil(std::max(life, 0.0f) * rate) + 2);
+}
 
-	Particle particle;
+// spawn n particles.  time is current time of birth
+//
+int ParticleEmitter::spawn(float time, int n) {
+	PROFILE_SCOPE("ParticleEmitter::spawn");
+	ALLOC_TAG(ALLOC_EMITTERS);
+	ParticleStore &store = sys->particles;
+	int first = store.size();
+	n = store.append(n);
+	if (n == 0) return 0;
 
-	// set initial velocity and position
-	// based on emitter type
+	// one switch per burst, the per particle loops are specialized per shape
 	//
 	switch (type) {
+	case DirectionalEmitter:
+		spawnShape<DirectionalShape>(time, first, n);
+		break;
 	case RadialEmitter:
-	{
-		ofVec3f dir = ofVec3f(ofRandom(-1, 1), ofRandom(-1, 1), ofRandom(-1, 1));
-		float speed = velocity.length();
-		particle.velocity = dir.getNormalized() * speed;
-		particle.position.set(position);
-	}
-	break;
+		spawnShape<RadialShape>(time, first, n);
+		break;
 	case SphereEmitter:
+		spawnShape<SphereShape>(time, first, n);
 		break;
-	case DirectionalEmitter:
-		particle.velocity = velocity;
-		particle.position.set(position);
+	case DiscEmitter:
+		spawnShape<DiscShape>(time, first, n);
 		break;
 	}
+	return n;
+}
 
-	// other particle attributes
-	//
-	if (randomLife) {
-		particle.lifespan = ofRandom(lifeMinMax.x, lifeMinMax.y);
+// fill particles [first, first + n) of the system in place, in batches of
+// random numbers.  Particle k of the emitter uses counter (spawnCount + k, 0).
+//
+template <typename Shape>
+void ParticleEmitter::spawnShape(float time, int first, int n) {
+	ParticleStore &s = sys->particles;
+	const int batch = 64;
+	uint32_t counter[batch];
+	float r0[batch], r1[batch], r2[batch], r3[batch];
+
+	for (int b = first; b < first + n; b += batch) {
+		int m = std::min(batch, first + n - b);
+		for (int i = 0; i < m; i++) counter[i] = spawnCount++;
+		rng.fill(counter, 0, m, r0, r1, r2, r3);
+
+		EmitterBatch eb = { m, r0, r1, r2,
+			&s.px[b], &s.py[b], &s.pz[b], &s.vx[b], &s.vy[b], &s.vz[b] };
+		Shape::emit(*this, eb);
+
+		// other particle attributes
+		//
+		float *life = &s.lifespan[b];
+		if (randomLife) {
+			float lo = lifeMinMax.x;
+			float range = lifeMinMax.y - lifeMinMax.x;
+			for (int i = 0; i < m; i++) life[i] = lo + range * r3[i];
+		}
+		else std::fill(life, life + m, lifespan);
 	}
-	else particle.lifespan = lifespan;
-	particle.birthtime = time;
-	particle.radius = particleRadius;
-	particle.mass = mass;
-	particle.damping = damping;
 
-	// add to system
-	//
-	sys->add(particle);
+	FloatArray *zero[] = { &s.ax, &s.ay, &s.az, &s.fx, &s.fy, &s.fz };
+	for (FloatArray *a : zero)
+		std::fill(a->begin() + first, a->begin() + first + n, 0.0f);
+	std::fill(&s.birthtime[first], &s.birthtime[first] + n, time);
+	std::fill(&s.radius[first], &s.radius[first] + n, particleRadius);
+	std::fill(&s.mass[first], &s.mass[first] + n, mass);
+	std::fill(&s.damping[first], &s.damping[first] + n, damping);
+	std::fill(&s.color[first], &s.color[first] + n, ofColor(ofColor::aquamarine));
+}
+
+void DirectionalShape::emit(const ParticleEmitter &e, const EmitterBatch &b) {
+	ofVec3f p = e.position;
+	ofVec3f v = e.velocity;
+	for (int i = 0; i < b.n; i++) {
+		b.px[i] = p.x;
+		b.py[i] = p.y;
+		b.pz[i] = p.z;
+		b.vx[i] = v.x;
+		b.vy[i] = v.y;
+		b.vz[i] = v.z;
+	}
+}
+
+// direction is a random point in the unit cube, normalized
+//
+void RadialShape::emit(const ParticleEmitter &e, const EmitterBatch &b) {
+	ofVec3f p = e.position;
+	float speed = e.velocity.length();
+	for (int i = 0; i < b.n; i++) {
+		float dx = b.r0[i] * 2 - 1;
+		float dy = b.r1[i] * 2 - 1;
+		float dz = b.r2[i] * 2 - 1;
+		float len = sqrtf(dx * dx + dy * dy + dz * dz);
+		float scale = len > 0 ? speed / len : 0;
+		b.px[i] = p.x;
+		b.py[i] = p.y;
+		b.pz[i] = p.z;
+		b.vx[i] = dx * scale;
+		b.vy[i] = dy * scale;
+		b.vz[i] = dz * scale;
+	}
+}
+
+// uniform on the sphere: y uniform in [-1, 1], angle uniform around y
+//
+void SphereShape::emit(const ParticleEmitter &e, const EmitterBatch &b) {
+	ofVec3f p = e.position;
+	float speed = e.velocity.length();
+	float radius = e.radius;
+	for (int i = 0; i < b.n; i++) {
+		float y = b.r0[i] * 2 - 1;
+		float angle = b.r1[i] * TWO_PI;
+		float ring = sqrtf(std::max(0.0f, 1 - y * y));
+		float x = ring * cosf(angle);
+		float z = ring * sinf(angle);
+		b.px[i] = p.x + x * radius;
+		b.py[i] = p.y + y * radius;
+		b.pz[i] = p.z + z * radius;
+		b.vx[i] = x * speed;
+		b.vy[i] = y * speed;
+		b.vz[i] = z * speed;
+	}
+}
+
+// uniform on the disc: sqrt of the random radius so the density is even
+//
+void DiscShape::emit(const ParticleEmitter &e, const EmitterBatch &b) {
+	ofVec3f p = e.position;
+	ofVec3f v = e.velocity;
+	float radius = e.radius;
+	for (int i = 0; i < b.n; i++) {
+		float r = radius * sqrtf(b.r0[i]);
+		float angle = b.r1[i] * TWO_PI;
+		b.px[i] = p.x + r * cosf(angle);
+		b.py[i] = p.y;
+		b.pz[i] = p.z + r * sinf(angle);
+		b.vx[i] = v.x;
+		b.vy[i] = v.y;
+		b.vz[i] = v.z;
+	}
 }
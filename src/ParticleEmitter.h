@@ -4,11 +4,48 @@
 #include "TransformObject.h"
 #include "ParticleSystem.h"
 
-typedef enum { DirectionalEmitter, RadialEmitter, SphereEmitter } EmitterType;
+typedef enum { DirectionalEmitter, RadialEmitter, SphereEmitter, DiscEmitter } EmitterType;
+
+class ParticleEmitter;
+
+//  Start positions and velocities for a batch of n new particles, filled
+//  in place in the ParticleStore arrays from three uniform random numbers
+//  per particle.
+//
+struct EmitterBatch {
+	int n;
+	const float *r0, *r1, *r2;      // uniform [0, 1)
+	float *px, *py, *pz;
+	float *vx, *vy, *vz;
+};
+
+//  Emitter shapes.  Each is one straight loop over the batch so the
+//  compiler can vectorize it; ParticleEmitter::spawn picks the shape once
+//  per burst and the loop is instantiated for each shape at compile time.
+//
+//  Directional - at the emitter, all with the emitter velocity
+//  Radial      - at the emitter, random direction at the emitter speed
+//  Sphere      - on the sphere of the emitter radius, moving outward
+//  Disc        - on the disc of the emitter radius in the xz plane, all
+//                with the emitter velocity
+//
+struct DirectionalShape { static void emit(const ParticleEmitter &e, const EmitterBatch &b); };
+struct RadialShape { static void emit(const ParticleEmitter &e, const EmitterBatch &b); };
+struct SphereShape { static void emit(const ParticleEmitter &e, const EmitterBatch &b); };
+struct DiscShape { static void emit(const ParticleEmitter &e, const EmitterBatch &b); };
 
 //  General purpose Emitter class for emitting sprites
 //  This works similar to a Particle emitter
 //
+//  Spawning draws from a CounterRNG on stream 3, counted per particle
+//  spawned.  Emitters with the same seed spawn the same particles, so give
+//  each one its own (setSeed).
+//
+//  The particle system is a fixed capacity pool (4096 particles unless
+//  set otherwise); a burst that doesn't fit is cut short.  Once rate, group
+//  size and lifespan are set, size it with
+//  sys->setCapacity(getPeakCount()).
+//
 class ParticleEmitter : public TransformObject {
 public:
 	ParticleEmitter();
@@ -29,8 +66,19 @@ public:
 	void setLifespanRange(const ofVec2f &r) { lifeMinMax = r; }
 	void setMass(float m) { mass = m; }
 	void setDamping(float d) { damping = d; }
-	void update();
-	void spawn(float time);
+	void setSeed(uint32_t s) { rng.setSeed(s); }
+	void update(float dt, float time);
+
+	// spawn n particles born at "time", returns the number spawned (less
+	// than n if the system is full)
+	//
+	int spawn(float time, int n = 1);
+
+	// most particles alive at once with the current rate, group size and
+	// lifespan, for sizing the system.  Particles that never expire
+	// (lifespan -1) aren't bounded by it.
+	//
+	int getPeakCount() const;
 	ParticleSystem *sys;
 	float rate;         // per sec
 	bool oneShot;
@@ -42,11 +90,17 @@ public:
 	float mass;
 	float damping;
 	bool started;
-	float lastSpawned;  // ms
+	float lastSpawned;  // sec
+	float time;         // sec, simulation time of the last update
 	float particleRadius;
 	float radius;
 	bool visible;
 	int groupSize;      // number of particles to spawn in a group
 	bool createdSys;
 	EmitterType type;
+	CounterRNG rng;
+	uint32_t spawnCount; // counter for rng, one per particle spawned
+
+private:
+	template <typename Shape> void spawnShape(float time, int first, int n);
 };
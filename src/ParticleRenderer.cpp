@@ -0,0 +1,208 @@
+
+#include "ParticleRenderer.h"
+#include "Profiler.h"
+#include "AllocTracker.h"
+
+ParticleRenderer::~ParticleRenderer() {
+	if (vao != 0) glDeleteVertexArrays(1, &vao);
+}
+
+bool ParticleRenderer::setup(const string &texturePath) {
+	if (!ofLoadImage(texture, texturePath)) {
+		cout << "Particle Texture File: " << texturePath << " not found." << endl;
+		return false;
+	}
+
+#ifdef TARGET_OPENGLES
+	string shaderPath = "shaders_gles/particle";
+#else
+	string shaderPath = ofIsGLProgrammableRenderer() ? "shaders_gl3/particle" : "shaders/particle";
+#endif
+
+	// attribute locations have to be bound before linking
+	//
+	if (!shader.setupShaderFromFile(GL_VERTEX_SHADER, shaderPath + ".vert") ||
+		!shader.setupShaderFromFile(GL_FRAGMENT_SHADER, shaderPath + ".frag")) {
+		cout << "Particle Shader: " << shaderPath << " failed to load." << endl;
+		return false;
+	}
+	shader.bindAttribute(POSITION, "position");
+	shader.bindAttribute(COLOR, "color");
+	shader.bindAttribute(SIZE, "size");
+	shader.bindAttribute(AGE, "age");
+	if (!shader.linkProgram()) {
+		cout << "Particle Shader: " << shaderPath << " failed to link." << endl;
+		return false;
+	}
+
+	// the core profile has no default vertex array object
+	//
+	if (ofIsGLProgrammableRenderer()) glGenVertexArrays(1, &vao);
+	return true;
+}
+
+// register a system, returns its layer index
+//
+int ParticleRenderer::add(const ofColor &color, float size) {
+	Layer layer;
+	layer.color = color;
+	layer.size = size;
+	layers.push_back(layer);
+	return (int)layers.size() - 1;
+}
+
+void ParticleRenderer::allocate(int n) {
+	capacity = n;
+	count = 0;
+	buffer.allocate(capacity * sizeof(Vertex), GL_STREAM_DRAW);
+#ifdef TARGET_OPENGLES
+	staging.resize(capacity);
+#endif
+}
+
+// IEEE 754 binary16, round to nearest even.  Values too small for a normal
+// half become subnormals (or 0), values too large become the largest half
+// (65504).  NaN stays NaN.
+//
+uint16_t ParticleRenderer::toHalf(float f) {
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	uint16_t sign = (bits >> 16) & 0x8000;
+	uint32_t abs = bits & 0x7fffffff;
+	if (abs > 0x7f800000) return sign | 0x7e00;
+	int exponent = (int)(abs >> 23) - 127 + 15;
+	if (exponent >= 31) return sign | 0x7bff;
+	if (exponent < -10) return sign;
+
+	// mantissa bits that don't fit go to rounding.  A subnormal shifts the
+	// implicit 1 in as well.
+	//
+	uint32_t mantissa = abs & 0x7fffff;
+	int shift = 13;
+	uint32_t h;
+	if (exponent > 0) {
+		h = (exponent << 10) | (mantissa >> shift);
+	}
+	else {
+		mantissa |= 0x800000;
+		shift = 14 - exponent;
+		h = mantissa >> shift;
+	}
+	uint32_t rest = mantissa & ((1u << shift) - 1);
+	uint32_t halfway = 1u << (shift - 1);
+	if (rest > halfway || (rest == halfway && (h & 1))) h++;    // may carry into the exponent
+	return sign | std::min(h, 0x7bffu);
+}
+
+// pack every layer into v, one after the other
+//
+void ParticleRenderer::write(Vertex *v) const {
+	for (int l = 0; l < layers.size(); l++) {
+		if (layers[l].particles == NULL) continue;
+		const ParticleSnapshot &p = *layers[l].particles;
+		const ofColor &c = layers[l].color;
+		uint16_t size = toHalf(layers[l].size);
+		for (int i = 0; i < p.size(); i++, v++) {
+			v->x = p.px[i];
+			v->y = p.py[i];
+			v->z = p.pz[i];
+			v->size = size;
+			v->age = p.age[i];
+			v->r = c.r;
+			v->g = c.g;
+			v->b = c.b;
+			v->a = c.a;
+		}
+	}
+}
+
+void ParticleRenderer::update() {
+	PROFILE_SCOPE("ParticleRenderer::update");
+	ALLOC_TAG(ALLOC_RENDERER);
+	int total = 0;
+	for (int l = 0; l < layers.size(); l++) {
+		if (layers[l].particles) total += layers[l].particles->size();
+	}
+
+	// grow by doubling so a growing particle count reallocates rarely
+	//
+	if (total > capacity) allocate(std::max(total, std::max(capacity * 2, 4096)));
+	count = total;
+	if (count == 0) return;
+
+#ifdef TARGET_OPENGLES
+	write(staging.data());
+	buffer.updateData(0, count * sizeof(Vertex), staging.data());
+#else
+	Vertex *v = buffer.mapRange<Vertex>(0, count * sizeof(Vertex),
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (v == NULL) {
+		count = 0;
+		return;
+	}
+	write(v);
+	buffer.unmap();
+#endif
+}
+
+void ParticleRenderer::bindAttributes() const {
+	if (vao != 0) glBindVertexArray(vao);
+	buffer.bind(GL_ARRAY_BUFFER);
+	glEnableVertexAttribArray(POSITION);
+	glEnableVertexAttribArray(COLOR);
+	glEnableVertexAttribArray(SIZE);
+	glEnableVertexAttribArray(AGE);
+	glVertexAttribPointer(POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void *)offsetof(Vertex, x));
+	glVertexAttribPointer(COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (const void *)offsetof(Vertex, r));
+	glVertexAttribPointer(SIZE, 1, GL_HALF_FLOAT, GL_FALSE, sizeof(Vertex), (const void *)offsetof(Vertex, size));
+	glVertexAttribPointer(AGE, 1, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(Vertex), (const void *)offsetof(Vertex, age));
+}
+
+void ParticleRenderer::unbindAttributes() const {
+	glDisableVertexAttribArray(POSITION);
+	glDisableVertexAttribArray(COLOR);
+	glDisableVertexAttribArray(SIZE);
+	glDisableVertexAttribArray(AGE);
+	buffer.unbind(GL_ARRAY_BUFFER);
+	if (vao != 0) glBindVertexArray(0);
+}
+
+// all layers in one draw.  Call between camera begin() and end().
+//
+void ParticleRenderer::draw() const {
+	PROFILE_SCOPE("ParticleRenderer::draw");
+	if (count == 0) return;
+	shader.begin();
+	shader.setUniform2f("sizeOverLife", sizeStart, sizeEnd);
+	shader.setUniform1f("fadeStart", fadeStart);
+	ofEnablePointSprites();
+	texture.bind();
+	bindAttributes();
+	glDrawArrays(GL_POINTS, 0, count);
+	unbindAttributes();
+	texture.unbind();
+	ofDisablePointSprites();
+	shader.end();
+}
+
+int ParticleRenderer::verify() {
+	if (count == 0) return 0;
+
+	vector<Vertex> expected(count);
+	write(expected.data());
+
+#ifdef TARGET_OPENGLES
+	const Vertex *v = staging.data();
+#else
+	const Vertex *v = buffer.mapRange<Vertex>(0, count * sizeof(Vertex), GL_MAP_READ_BIT);
+	if (v == NULL) return count;
+#endif
+	int bad = 0;
+	for (int i = 0; i < count; i++) {
+		if (memcmp(&v[i], &expected[i], sizeof(Vertex)) != 0) bad++;
+	}
+#ifndef TARGET_OPENGLES
+	buffer.unmap();
+#endif
+	return bad;
+}
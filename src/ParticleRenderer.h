@@ -0,0 +1,90 @@
+#pragma once
+#include "ofMain.h"
+#include "ParticleStore.h"
+
+//  Draws any number of particle systems as point sprites with one draw call.
+//
+//  Each system is registered as a layer with its own color and point size,
+//  and every frame gets the layer's particles as a ParticleSnapshot taken by
+//  the simulation thread.  update() copies all layers into one shared vertex
+//  buffer, which only grows, and draw() binds the sprite texture and shader
+//  once and draws everything.
+//
+//  Every particle carries its own size, color and normalized age, so fading
+//  and growing/shrinking over the particle's life happen in the shader
+//  (data/shaders*/particle.vert).  The shader is picked to match the
+//  renderer: shaders_gl3 for the programmable (core profile) renderer,
+//  shaders for the fixed function one and shaders_gles for GLES 3.
+//
+//  The buffer is mapped with GL_MAP_INVALIDATE_BUFFER_BIT so the driver can
+//  orphan the storage of the previous frame instead of stalling.  On GLES,
+//  where ofBufferObject has no mapping, the vertices are packed into a
+//  staging copy and uploaded with updateData().
+//
+class ParticleRenderer {
+public:
+	~ParticleRenderer();
+	bool setup(const string &texturePath);
+	int add(const ofColor &color, float size);
+	void setParticles(int layer, const ParticleSnapshot *p) { layers[layer].particles = p; }
+	void setColor(int layer, const ofColor &color) { layers[layer].color = color; }
+	void setSize(int layer, float size) { layers[layer].size = size; }
+
+	// size multiplier at birth and at the end of life, and the normalized
+	// age (0 - 1) where particles start to fade out
+	//
+	void setSizeOverLife(float start, float end) { sizeStart = start; sizeEnd = end; }
+	void setFadeStart(float age) { fadeStart = age; }
+
+	// copy the layers' snapshots into the buffer.  The snapshots must stay
+	// put until draw() (and verify()).
+	//
+	void update();
+	void draw() const;
+
+	// read the buffer back and compare with the snapshots, for checking
+	// uploads on a (software) GL context.  Returns the number of mismatches.
+	//
+	int verify();
+
+	int getCount() const { return count; }
+	int getCapacity() const { return capacity; }
+
+	// 20 bytes per particle, see the attributes in particle.vert
+	//
+	struct Vertex {
+		float x, y, z;
+		uint16_t size;      // half float
+		uint16_t age;       // normalized, 0 at birth .. 65535 at end of life
+		uint8_t r, g, b, a;
+	};
+
+	enum Attribute { POSITION = 0, COLOR = 1, SIZE = 2, AGE = 3 };
+
+	static uint16_t toHalf(float f);
+
+private:
+	struct Layer {
+		const ParticleSnapshot *particles = NULL;
+		ofColor color;
+		float size;
+	};
+	void allocate(int capacity);
+	void write(Vertex *v) const;
+	void bindAttributes() const;
+	void unbindAttributes() const;
+
+	vector<Layer> layers;
+	ofBufferObject buffer;
+	ofShader shader;
+	ofTexture texture;
+	GLuint vao = 0;
+	int capacity = 0;
+	int count = 0;
+	float sizeStart = 1;
+	float sizeEnd = 1;
+	float fadeStart = 0.5;
+#ifdef TARGET_OPENGLES
+	vector<Vertex> staging;    // ofBufferObject can't map on GLES
+#endif
+};
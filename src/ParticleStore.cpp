@@ -0,0 +1,260 @@
+
+#include "ParticleStore.h"
+
+#if defined(PARTICLE_SIMD_AVX) || defined(PARTICLE_SIMD_SSE)
+#include <immintrin.h>
+#endif
+
+// (re)allocate all slots.  Live particles beyond the new capacity are lost,
+// and the live ones get new handles (ParticleSystem::setCapacity
+// reschedules their expiry).
+//
+void ParticleStore::setCapacity(int n) {
+	FloatArray *arrays[] = { &px, &py, &pz, &vx, &vy, &vz, &ax, &ay, &az,
+		&fx, &fy, &fz, &damping, &mass, &lifespan, &radius, &birthtime };
+	for (FloatArray *a : arrays)
+		a->resize(n);
+	color.resize(n);
+	id.resize(n);
+	handle.resize(n);
+	maxCount = n;
+	if (count > n) count = n;
+	bDropped = false;
+	resetHandles();
+}
+
+void ParticleStore::clear() {
+	count = 0;
+	nextId = 0;
+	resetHandles();
+}
+
+// give the live particles handles 0 .. count - 1, all others are free
+//
+void ParticleStore::resetHandles() {
+	slot.assign(maxCount, -1);
+	freeHandles.clear();
+	for (int h = maxCount - 1; h >= count; h--)
+		freeHandles.push_back(h);
+	for (int i = 0; i < count; i++) {
+		handle[i] = i;
+		slot[i] = i;
+	}
+}
+
+uint32_t ParticleStore::allocHandle(int i) {
+	uint32_t h = freeHandles.back();
+	freeHandles.pop_back();
+	handle[i] = h;
+	slot[h] = i;
+	return h;
+}
+
+// report the first particles lost to a full store, once per capacity
+//
+void ParticleStore::dropped(int n) {
+	if (bDropped) return;
+	bDropped = true;
+	cout << "ParticleStore: full at " << maxCount << " particles, dropped " << n
+		<< " (further drops are not reported)" << endl;
+}
+
+bool ParticleStore::add(const Particle &p) {
+	if (count == maxCount) {
+		dropped(1);
+		return false;
+	}
+
+	int i = count++;
+	px[i] = p.position.x;
+	py[i] = p.position.y;
+	pz[i] = p.position.z;
+	vx[i] = p.velocity.x;
+	vy[i] = p.velocity.y;
+	vz[i] = p.velocity.z;
+	ax[i] = p.acceleration.x;
+	ay[i] = p.acceleration.y;
+	az[i] = p.acceleration.z;
+	fx[i] = p.forces.x;
+	fy[i] = p.forces.y;
+	fz[i] = p.forces.z;
+	damping[i] = p.damping;
+	mass[i] = p.mass;
+	lifespan[i] = p.lifespan;
+	radius[i] = p.radius;
+	birthtime[i] = p.birthtime;
+	color[i] = p.color;
+	id[i] = nextId++;
+	allocHandle(i);
+	return true;
+}
+
+int ParticleStore::append(int n) {
+	if (n > maxCount - count) {
+		dropped(n - (maxCount - count));
+		n = maxCount - count;
+	}
+	for (int i = count; i < count + n; i++) {
+		id[i] = nextId++;
+		allocHandle(i);
+	}
+	count += n;
+	return n;
+}
+
+// remove particle i in O(1) by moving the last particle into its slot
+//
+void ParticleStore::remove(int i) {
+	freeHandles.push_back(handle[i]);
+	slot[handle[i]] = -1;
+	int last = --count;
+	if (i != last) move(last, i);
+}
+
+void ParticleStore::move(int from, int to) {
+	px[to] = px[from];
+	py[to] = py[from];
+	pz[to] = pz[from];
+	vx[to] = vx[from];
+	vy[to] = vy[from];
+	vz[to] = vz[from];
+	ax[to] = ax[from];
+	ay[to] = ay[from];
+	az[to] = az[from];
+	fx[to] = fx[from];
+	fy[to] = fy[from];
+	fz[to] = fz[from];
+	damping[to] = damping[from];
+	mass[to] = mass[from];
+	lifespan[to] = lifespan[from];
+	radius[to] = radius[from];
+	birthtime[to] = birthtime[from];
+	color[to] = color[from];
+	id[to] = id[from];
+	handle[to] = handle[from];
+	slot[handle[to]] = to;
+}
+
+// copy of particle i as a Particle
+//
+Particle ParticleStore::get(int i) const {
+	Particle p;
+	p.position.set(px[i], py[i], pz[i]);
+	p.velocity.set(vx[i], vy[i], vz[i]);
+	p.acceleration.set(ax[i], ay[i], az[i]);
+	p.forces.set(fx[i], fy[i], fz[i]);
+	p.damping = damping[i];
+	p.mass = mass[i];
+	p.lifespan = lifespan[i];
+	p.radius = radius[i];
+	p.birthtime = birthtime[i];
+	p.color = color[i];
+	return p;
+}
+
+// Same integrator as Particle::integrate, one axis at a time over the
+// whole store:
+//
+//   position += velocity * dt
+//   velocity += (acceleration + forces / mass) * dt
+//   velocity *= stepDamping(damping, dt)
+//   forces = 0
+//
+// The per step damping is worked out a block of particles at a time.
+// Particles from one emitter share their damping, so pow() runs about once
+// per block.
+//
+void ParticleStore::integrate(float dt, int begin, int end) {
+	const int block = 64;
+	float damp[block];
+	float lastDamping = 1, lastStep = stepDamping(1, dt);
+	for (int b = begin; b < end; b += block) {
+		int n = std::min(block, end - b);
+		for (int i = 0; i < n; i++) {
+			if (damping[b + i] != lastDamping) {
+				lastDamping = damping[b + i];
+				lastStep = stepDamping(lastDamping, dt);
+			}
+			damp[i] = lastStep;
+		}
+		integrateBlock(dt, b, n, damp);
+	}
+}
+
+// particles [begin, begin + n) with their per step damping d[0 .. n)
+//
+void ParticleStore::integrateBlock(float dt, int begin, int n, const float *d) {
+	float *p[3] = { px.data() + begin, py.data() + begin, pz.data() + begin };
+	float *v[3] = { vx.data() + begin, vy.data() + begin, vz.data() + begin };
+	const float *a[3] = { ax.data() + begin, ay.data() + begin, az.data() + begin };
+	float *f[3] = { fx.data() + begin, fy.data() + begin, fz.data() + begin };
+	const float *m = mass.data() + begin;
+
+	// loads are unaligned so any range can be integrated
+	//
+	int i = 0;
+#if defined(PARTICLE_SIMD_AVX)
+	const __m256 vdt = _mm256_set1_ps(dt);
+	const __m256 zero = _mm256_setzero_ps();
+	for (; i + 8 <= n; i += 8) {
+		__m256 invMass = _mm256_div_ps(_mm256_set1_ps(1), _mm256_loadu_ps(m + i));
+		__m256 damp = _mm256_loadu_ps(d + i);
+		for (int k = 0; k < 3; k++) {
+			__m256 vel = _mm256_loadu_ps(v[k] + i);
+			__m256 pos = _mm256_add_ps(_mm256_loadu_ps(p[k] + i), _mm256_mul_ps(vel, vdt));
+			__m256 accel = _mm256_add_ps(_mm256_loadu_ps(a[k] + i), _mm256_mul_ps(_mm256_loadu_ps(f[k] + i), invMass));
+			vel = _mm256_mul_ps(_mm256_add_ps(vel, _mm256_mul_ps(accel, vdt)), damp);
+			_mm256_storeu_ps(p[k] + i, pos);
+			_mm256_storeu_ps(v[k] + i, vel);
+			_mm256_storeu_ps(f[k] + i, zero);
+		}
+	}
+#elif defined(PARTICLE_SIMD_SSE)
+	const __m128 vdt = _mm_set1_ps(dt);
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= n; i += 4) {
+		__m128 invMass = _mm_div_ps(_mm_set1_ps(1), _mm_loadu_ps(m + i));
+		__m128 damp = _mm_loadu_ps(d + i);
+		for (int k = 0; k < 3; k++) {
+			__m128 vel = _mm_loadu_ps(v[k] + i);
+			__m128 pos = _mm_add_ps(_mm_loadu_ps(p[k] + i), _mm_mul_ps(vel, vdt));
+			__m128 accel = _mm_add_ps(_mm_loadu_ps(a[k] + i), _mm_mul_ps(_mm_loadu_ps(f[k] + i), invMass));
+			vel = _mm_mul_ps(_mm_add_ps(vel, _mm_mul_ps(accel, vdt)), damp);
+			_mm_storeu_ps(p[k] + i, pos);
+			_mm_storeu_ps(v[k] + i, vel);
+			_mm_storeu_ps(f[k] + i, zero);
+		}
+	}
+#endif
+
+	// remainder (or everything without SIMD)
+	//
+	for (; i < n; i++) {
+		float invMass = 1.0 / m[i];
+		for (int k = 0; k < 3; k++) {
+			p[k][i] += v[k][i] * dt;
+			v[k][i] += (a[k][i] + f[k][i] * invMass) * dt;
+			v[k][i] *= d[i];
+			f[k][i] = 0;
+		}
+	}
+}
+
+void ParticleSnapshot::copy(const ParticleStore &store, float time) {
+   count = store.size();
+   if (px.size() < count) {
+      px.resize(count);
+      py.resize(count);
+      pz.resize(count);
+      age.resize(count);
+   }
+   std::copy(store.px.begin(), store.px.begin() + count, px.begin());
+   std::copy(store.py.begin(), store.py.begin() + count, py.begin());
+   std::copy(store.pz.begin(), store.pz.begin() + count, pz.begin());
+   for (int i = 0; i < count; i++) {
+      float a = 0;
+      if (store.lifespan[i] > 0)
+         a = ofClamp((time - store.birthtime[i]) / store.lifespan[i], 0, 1);
+      age[i] = (uint16_t)(a * 65535 + 0.5f);
+   }
+}
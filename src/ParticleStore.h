@@ -0,0 +1,198 @@
+#pragma once
+
+#include "ofMain.h"
+#include "Particle.h"
+
+#if defined(__AVX__)
+#define PARTICLE_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PARTICLE_SIMD_SSE
+#endif
+
+//  Allocator returning memory aligned for SIMD loads and stores.
+//
+template <typename T, size_t Align = 32>
+class AlignedAllocator {
+public:
+   typedef T value_type;
+   template <typename U> struct rebind { typedef AlignedAllocator<U, Align> other; };
+
+   AlignedAllocator() {}
+   template <typename U> AlignedAllocator(const AlignedAllocator<U, Align> &) {}
+
+   T * allocate(size_t n) {
+      // over allocate and keep the original pointer just before the aligned block
+      //
+      void *raw = malloc(n * sizeof(T) + Align + sizeof(void *));
+      if (raw == NULL) throw std::bad_alloc();
+      uintptr_t start = (uintptr_t)raw + sizeof(void *);
+      uintptr_t aligned = (start + Align - 1) & ~(uintptr_t)(Align - 1);
+      ((void **)aligned)[-1] = raw;
+      return (T *)aligned;
+   }
+   void deallocate(T *p, size_t) {
+      if (p) free(((void **)p)[-1]);
+   }
+   template <typename U> bool operator==(const AlignedAllocator<U, Align> &) const { return true; }
+   template <typename U> bool operator!=(const AlignedAllocator<U, Align> &) const { return false; }
+};
+
+typedef vector<float, AlignedAllocator<float> > FloatArray;
+typedef vector<uint32_t, AlignedAllocator<uint32_t> > IdArray;
+
+//  Reference to the x, y, z components of one particle attribute stored in
+//  three separate arrays.  Reads like an ofVec3f.
+//
+class Vec3Ref {
+public:
+   Vec3Ref(float &x, float &y, float &z) : x(x), y(y), z(z) {}
+   Vec3Ref(const Vec3Ref &) = default;
+   operator ofVec3f() const { return ofVec3f(x, y, z); }
+   Vec3Ref & operator=(const Vec3Ref &v) { return *this = ofVec3f(v); }
+   Vec3Ref & operator=(const ofVec3f &v) { x = v.x; y = v.y; z = v.z; return *this; }
+   Vec3Ref & operator+=(const ofVec3f &v) { x += v.x; y += v.y; z += v.z; return *this; }
+   Vec3Ref & operator-=(const ofVec3f &v) { x -= v.x; y -= v.y; z -= v.z; return *this; }
+   Vec3Ref & operator*=(float s) { x *= s; y *= s; z *= s; return *this; }
+   float &x;
+   float &y;
+   float &z;
+};
+
+//  Reference to one particle in a ParticleStore, so code written against
+//  Particle (particles[0].position, .velocity ...) keeps working.
+//
+class ParticleRef {
+public:
+   Vec3Ref position;
+   Vec3Ref velocity;
+   Vec3Ref acceleration;
+   Vec3Ref forces;
+   float &damping;
+   float &mass;
+   float &lifespan;
+   float &radius;
+   float &birthtime;
+   ofColor &color;
+   uint32_t &id;
+   uint32_t &frame;
+};
+
+//  Struct-of-arrays particle storage.  Each attribute lives in its own
+//  aligned array so the integrator can advance several particles with one
+//  SIMD instruction.
+//
+//  The store is a fixed capacity pool: all slots are allocated up front and
+//  live particles are kept packed in [0, size()), so adding never
+//  reallocates.  Adding to a full store drops the particle; the first drop
+//  after setCapacity() is reported on the console.
+//
+class ParticleStore {
+public:
+   ParticleStore(int capacity = 4096) { setCapacity(capacity); }
+   void setCapacity(int);
+   int capacity() const { return maxCount; }
+   int size() const { return count; }
+   bool empty() const { return count == 0; }
+   bool full() const { return count == maxCount; }
+   bool add(const Particle &);
+
+   // append up to n uninitialized particles at the end, returns the number
+   // actually appended (less than n when the store fills up).  The new
+   // particles are [size() - appended, size()) and only have their id and
+   // handle set, the caller fills in every other attribute.
+   //
+   int append(int n);
+   void remove(int i);
+   void clear();
+
+   // index of the particle with handle h, -1 if it has been removed.
+   // Handles stay the same while particles move around in the arrays, but
+   // are reused after removal; check id to tell particles apart.
+   //
+   int indexOf(uint32_t h) const { return slot[h]; }
+
+   // remove every particle i for which dead(i) is true in one pass,
+   // keeping the order of the survivors.  Returns the number removed.
+   //
+   template <typename Pred> int compact(Pred dead) {
+      int n = 0;
+      for (int i = 0; i < count; i++) {
+         if (dead(i)) {
+            freeHandles.push_back(handle[i]);
+            slot[handle[i]] = -1;
+            continue;
+         }
+         if (n != i) move(i, n);
+         n++;
+      }
+      int removed = count - n;
+      count = n;
+      return removed;
+   }
+
+   Particle get(int i) const;
+   ParticleRef operator[](int i) {
+      return ParticleRef{
+         Vec3Ref(px[i], py[i], pz[i]),
+         Vec3Ref(vx[i], vy[i], vz[i]),
+         Vec3Ref(ax[i], ay[i], az[i]),
+         Vec3Ref(fx[i], fy[i], fz[i]),
+         damping[i], mass[i], lifespan[i], radius[i], birthtime[i], color[i], id[i], frame };
+   }
+
+   // integrate particles [begin, end) over the interval dt (sec)
+   //
+   void integrate(float dt) { integrate(dt, 0, count); }
+   void integrate(float dt, int begin, int end);
+
+   FloatArray px, py, pz;     // position
+   FloatArray vx, vy, vz;     // velocity
+   FloatArray ax, ay, az;     // acceleration
+   FloatArray fx, fy, fz;     // accumulated forces
+   FloatArray damping;
+   FloatArray mass;
+   FloatArray lifespan;       // sec
+   FloatArray radius;
+   FloatArray birthtime;      // sec
+   vector<ofColor> color;
+   IdArray id;                // unique per particle, in the order they were added
+   IdArray handle;            // stable handle of the particle in each slot, see indexOf
+
+   // step counter of the owning system.  Together with id it is the
+   // counter for random numbers, see CounterRNG.
+   //
+   uint32_t frame = 0;
+
+private:
+   void move(int from, int to);
+   void integrateBlock(float dt, int begin, int n, const float *damp);
+   uint32_t allocHandle(int i);
+   void resetHandles();
+   void dropped(int n);
+
+   vector<int> slot;                // handle -> index
+   vector<uint32_t> freeHandles;
+
+   int count = 0;
+   int maxCount = 0;
+   uint32_t nextId = 0;
+   bool bDropped = false;
+};
+
+//  Copy of what gets drawn from a ParticleStore: positions and the age
+//  normalized to 0 (birth) .. 65535 (end of life).  Written by the
+//  simulation thread, read by the renderer (see SimThread.h).  The arrays
+//  only grow, so copying into the same snapshot each step doesn't allocate
+//  once it has seen the largest store.
+//
+class ParticleSnapshot {
+public:
+   void copy(const ParticleStore &store, float time);
+   int size() const { return count; }
+
+   FloatArray px, py, pz;
+   vector<uint16_t> age;
+
+private:
+   int count = 0;
+};
@@ -2,9 +2,36 @@
 // Kevin M.Smith - CS 134 SJSU
 
 #include "ParticleSystem.h"
+#include "Profiler.h"
+#include "AllocTracker.h"
+#include "FrameArena.h"
 
 void ParticleSystem::add(const Particle &p) {
-	particles.push_back(p);
+	particles.add(p);
+}
+
+// number of particle slots, allocated once.  Particles added to a full
+// system are dropped.
+//
+void ParticleSystem::setCapacity(int n) {
+	particles.setCapacity(n);
+
+	// the store gave out new handles, reschedule everything on the next
+	// update
+	//
+	expiry.clear();
+	scheduled = 0;
+}
+
+// update systems of at least minParallel particles in chunks on the pool's
+// threads.  Chunks are chunkSize particles (the last one less) regardless
+// of the number of threads, so results don't depend on how the chunks get
+// scheduled.
+//
+void ParticleSystem::setJobPool(JobPool *pool, int minParallel, int chunkSize) {
+	jobs = pool;
+	this->minParallel = minParallel;
+	this->chunkSize = chunkSize;
 }
 
 void ParticleSystem::addForce(ParticleForce *f) {
@@ -15,6 +42,11 @@ void ParticleSystem::setLifespan(float l) {
    for (int i = 0; i < particles.size(); i++) {
       particles[i].lifespan = l;
    }
+
+   // reschedule everything on the next update
+   //
+   expiry.clear();
+   scheduled = 0;
 }
 
 void ParticleSystem::reset() {
@@ -23,32 +55,42 @@ void ParticleSystem::reset() {
    }
 }
 
-void ParticleSystem::update() {
+// advance the system one step of dt seconds, ending at simulation time "time"
+//
+void ParticleSystem::update(float dt, float time) {
+	PROFILE_SCOPE("ParticleSystem::update");
+	ALLOC_TAG(ALLOC_PARTICLES);
 	// check if empty and just return
 	if (particles.size() == 0) return;
 
-	vector<Particle>::iterator p = particles.begin();
-	vector<Particle>::iterator tmp;
+	particles.frame++;
 
-	// check which particles have exceed their lifespan and delete
-	// from list.  When deleting multiple objects from a vector while
-	// traversing at the same time, we need to use an iterator.
+	// schedule the particles added since the last update (they are at the
+	// end of the store), then remove the ones that have exceeded their
+	// lifespan.  Only the particles that die are touched; removal moves the
+	// last particle into the hole, so a first particle that never expires
+	// (the ship) stays first.
 	//
-	while (p != particles.end()) {
-		if (p->lifespan != -1 && p->age() > p->lifespan) {
-			tmp = particles.erase(p);
-			p = tmp;
-		}
-		else p++;
+	if (scheduled > particles.size()) {
+		expiry.clear();
+		scheduled = 0;
+	}
+	for (int i = scheduled; i < particles.size(); i++)
+		expiry.schedule(particles, i);
+	expiry.expire(particles, time);
+	scheduled = particles.size();
+
+	int n = particles.size();
+	if (jobs != NULL && n >= minParallel) {
+		updateParallel(dt);
+		return;
 	}
 
-	// update forces on all particles first 
+	// update forces on all particles first, one batch per force
 	//
-	for (int i = 0; i < particles.size(); i++) {
-		for (int k = 0; k < forces.size(); k++) {
-         if (!forces[k]->applied)
-			   forces[k]->updateForce( &particles[i] );
-		}
+	for (int k = 0; k < forces.size(); k++) {
+		if (!forces[k]->applied)
+			forces[k]->updateForces(particles, 0, n);
 	}
 
    // update all forces only applied once to "applied"
@@ -61,16 +103,43 @@ void ParticleSystem::update() {
 
 	// integrate all the particles in the store
 	//
-	for (int i = 0; i < particles.size(); i++)
-		particles[i].integrate();
+	particles.integrate(dt);
+
+}
+
+// forces and integration for each chunk run together on the job pool.
+// Forces that aren't thread safe (custom forces by default) are applied
+// serially first.
+//
+void ParticleSystem::updateParallel(float dt) {
+	PROFILE_SCOPE("ParticleSystem::updateParallel");
+	int n = particles.size();
+	parallelUpdates++;
+	ArenaScope scope(FrameArena::local());
+	ArenaVector<ParticleForce *> parallelForces(FrameArena::local(), (int)forces.size());
+	for (int k = 0; k < forces.size(); k++) {
+		if (forces[k]->applied) continue;
+		if (forces[k]->isThreadSafe())
+			parallelForces.push_back(forces[k]);
+		else
+			forces[k]->updateForces(particles, 0, n);
+	}
 
+	jobs->parallelFor(0, n, chunkSize, [this, dt, &parallelForces](int begin, int end) {
+		PROFILE_SCOPE("particle chunk");
+		ALLOC_TAG(ALLOC_PARTICLES);
+		for (int k = 0; k < parallelForces.size(); k++)
+			parallelForces[k]->updateForces(particles, begin, end);
+		particles.integrate(dt, begin, end);
+	});
 }
 
 //  draw the particle cloud
 //
 void ParticleSystem::draw() {
 	for (int i = 0; i < particles.size(); i++) {
-		particles[i].draw();
+		ofSetColor(particles.color[i]);
+		ofDrawSphere(ofVec3f(particles.px[i], particles.py[i], particles.pz[i]), particles.radius[i]);
 	}
 }
 
@@ -80,11 +149,16 @@ GravityForce::GravityForce(const ofVec3f &g) {
 	gravity = g;
 }
 
-void GravityForce::updateForce(Particle * particle) {
+void GravityForce::updateForce(ParticleRef particle) {
 	//
 	// f = mg
 	//
-	particle->forces += gravity * particle->mass;
+	particle.forces += gravity * particle.mass;
+}
+
+void GravityForce::updateForces(ParticleStore &s, int begin, int end) {
+	for (int i = begin; i < end; i++)
+		apply(s, i);
 }
 
 // Turbulence Force Field 
@@ -94,14 +168,32 @@ TurbulenceForce::TurbulenceForce(const ofVec3f &min, const ofVec3f &max) {
    tmax = max;
 }
 
-void TurbulenceForce::updateForce(Particle * particle) {
+void TurbulenceForce::updateForce(ParticleRef particle) {
    //
    // We are going to add a little "noise" to a particles
    // forces to achieve a more natual look to the motion
    //
-   particle->forces.x += ofRandom(tmin.x, tmax.x);
-   particle->forces.y += ofRandom(tmin.y, tmax.y);
-   particle->forces.z += ofRandom(tmin.z, tmax.z);
+   float r[4];
+   rng.uniform4(particle.id, particle.frame, r);
+   particle.forces.x += tmin.x + (tmax.x - tmin.x) * r[0];
+   particle.forces.y += tmin.y + (tmax.y - tmin.y) * r[1];
+   particle.forces.z += tmin.z + (tmax.z - tmin.z) * r[2];
+}
+
+// random numbers for a whole batch of particles at once
+//
+void TurbulenceForce::updateForces(ParticleStore &s, int begin, int end) {
+   const int batch = 64;
+   float r0[batch], r1[batch], r2[batch], r3[batch];
+   for (int b = begin; b < end; b += batch) {
+      int n = std::min(batch, end - b);
+      rng.fill(&s.id[b], s.frame, n, r0, r1, r2, r3);
+      for (int i = 0; i < n; i++) {
+         s.fx[b + i] += tmin.x + (tmax.x - tmin.x) * r0[i];
+         s.fy[b + i] += tmin.y + (tmax.y - tmin.y) * r1[i];
+         s.fz[b + i] += tmin.z + (tmax.z - tmin.z) * r2[i];
+      }
+   }
 }
 
 // Impulse Radial Force - this is a "one shot" force that
@@ -112,25 +204,43 @@ ImpulseRadialForce::ImpulseRadialForce(float magnitude) {
    applyOnce = true;
 }
 
-void ImpulseRadialForce::updateForce(Particle * particle) {
+void ImpulseRadialForce::updateForce(ParticleRef particle) {
 
    // we basically create a random direction for each particle
    // the force is only added once after it is triggered.
    //
-   ofVec3f dir = ofVec3f(ofRandom(-1, 1), ofRandom(-height / 2.0, height / 2.0), ofRandom(-1, 1));
-   particle->forces += dir.getNormalized() * magnitude;
+   float r[4];
+   rng.uniform4(particle.id, particle.frame, r);
+   ofVec3f dir = ofVec3f(r[0] * 2 - 1, (r[1] - 0.5) * height, r[2] * 2 - 1);
+   particle.forces += dir.getNormalized() * magnitude;
+}
+
+void ImpulseRadialForce::updateForces(ParticleStore &s, int begin, int end) {
+   const int batch = 64;
+   float r0[batch], r1[batch], r2[batch], r3[batch];
+   for (int b = begin; b < end; b += batch) {
+      int n = std::min(batch, end - b);
+      rng.fill(&s.id[b], s.frame, n, r0, r1, r2, r3);
+      for (int i = 0; i < n; i++)
+         applyDir(s, b + i, r0[i] * 2 - 1, (r1[i] - 0.5) * height, r2[i] * 2 - 1);
+   }
 }
 
 CyclicForce::CyclicForce(float magnitude) {
    this->magnitude = magnitude;
 }
 
-void CyclicForce::updateForce(Particle * particle) {
+void CyclicForce::updateForce(ParticleRef particle) {
 
-   ofVec3f position = particle->position;
+   ofVec3f position = particle.position;
    ofVec3f norm = position.getNormalized();
    ofVec3f dir = norm.cross(ofVec3f(1, 0, 0));
-   particle->forces += dir.getNormalized() * magnitude;
+   particle.forces += dir.getNormalized() * magnitude;
+}
+
+void CyclicForce::updateForces(ParticleStore &s, int begin, int end) {
+   for (int i = begin; i < end; i++)
+      apply(s, i);
 }
 
 // Movement Forces
@@ -139,7 +249,13 @@ MovementForce::MovementForce(const ofVec3f & m)
    movement = m;
 }
 
-void MovementForce::updateForce(Particle * particle)
+void MovementForce::updateForce(ParticleRef particle)
 {
-   particle->forces += movement;
-}
\ No newline at end of file
+   particle.forces += movement;
+}
+
+void MovementForce::updateForces(ParticleStore &s, int begin, int end)
+{
+   for (int i = begin; i < end; i++)
+      apply(s, i);
+}
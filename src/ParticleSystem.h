@@ -1,8 +1,14 @@
 #pragma once
 //  Kevin M. Smith - CS 134 SJSU
 
+#include <tuple>
+#include <utility>
 #include "ofMain.h"
 #include "Particle.h"
+#include "ParticleStore.h"
+#include "ExpiryWheel.h"
+#include "JobPool.h"
+#include "Random.h"
 
 
 //  Pure Virtual Function Class - must be subclassed to create new forces.
@@ -12,67 +18,215 @@ protected:
 public:
    bool applyOnce = false;
    bool applied = false;
-   virtual void updateForce(Particle *) = 0;
+   virtual ~ParticleForce() {}
+   virtual void updateForce(ParticleRef) = 0;
+
+   // true if updateForces can run on several chunks of the store at once
+   //
+   virtual bool isThreadSafe() const { return false; }
+
+   // apply the force to particles [begin, end) of the store.  By default
+   // this calls updateForce() per particle; the built-in forces override it
+   // with a loop over the attribute arrays.
+   //
+   virtual void updateForces(ParticleStore &store, int begin, int end) {
+      for (int i = begin; i < end; i++)
+         updateForce(store[i]);
+   }
 };
 
 class ParticleSystem {
 public:
 	void add(const Particle &);
 	void addForce(ParticleForce *);
-	void update();
+	void setCapacity(int);
+	void setJobPool(JobPool *pool, int minParallel = 8192, int chunkSize = 2048);
+	void update(float dt, float time);
    void setLifespan(float);
    void reset();
 	void draw();
-	vector<Particle> particles;
+	ParticleStore particles;
 	vector<ParticleForce *> forces;
+
+	// particle deaths by tick.  Particles [0, scheduled) of the store are
+	// in the wheel; new particles are added at the end between updates.
+	//
+	ExpiryWheel expiry;
+	int scheduled = 0;
+
+	void updateParallel(float dt);
+
+	// parallel update; systems smaller than minParallel update serially
+	JobPool *jobs = NULL;
+	int minParallel = 8192;
+	int chunkSize = 2048;
+	int parallelUpdates = 0;    // updates that took the parallel path
 };
 
 
 
 // Some convenient built-in forces
 //
-class GravityForce: public ParticleForce {
+// Each one has an inline apply(store, i) kernel that updateForce() and
+// updateForces() share, and that ForcePipeline calls directly.
+//
+class GravityForce final : public ParticleForce {
 private:
 	ofVec3f gravity;
 public:
    GravityForce() {};
 	GravityForce(const ofVec3f & gravity);
-	void updateForce(Particle *);
+	void updateForce(ParticleRef);
+	void updateForces(ParticleStore &, int begin, int end);
+   bool isThreadSafe() const { return true; }
    void set(const ofVec3f &gravity) { this->gravity = gravity; };
+
+   // f = mg
+   void apply(ParticleStore &s, int i) const {
+      s.fx[i] += gravity.x * s.mass[i];
+      s.fy[i] += gravity.y * s.mass[i];
+      s.fz[i] += gravity.z * s.mass[i];
+   }
 };
 
-class TurbulenceForce : public ParticleForce {
+//  The random forces draw their numbers from a CounterRNG keyed on the
+//  particle id and the system's frame, so they are reproducible and can
+//  run on several threads.  Each kind of force has its own stream, but ids
+//  start at 0 in every system: give forces in different systems different
+//  seeds (setSeed) or they push the same way.
+//
+class TurbulenceForce final : public ParticleForce {
    ofVec3f tmin, tmax;
+   CounterRNG rng = CounterRNG(0, 1);
 public:
    void set(const ofVec3f &min, const ofVec3f &max) { tmin = min; tmax = max; }
+   void setSeed(uint32_t seed) { rng.setSeed(seed); }
    TurbulenceForce(const ofVec3f & min, const ofVec3f &max);
-   void updateForce(Particle *);
+   void updateForce(ParticleRef);
+   void updateForces(ParticleStore &, int begin, int end);
+   bool isThreadSafe() const { return true; }
+
+   void apply(ParticleStore &s, int i) const {
+      float r[4];
+      rng.uniform4(s.id[i], s.frame, r);
+      s.fx[i] += tmin.x + (tmax.x - tmin.x) * r[0];
+      s.fy[i] += tmin.y + (tmax.y - tmin.y) * r[1];
+      s.fz[i] += tmin.z + (tmax.z - tmin.z) * r[2];
+   }
 };
 
-class ImpulseRadialForce : public ParticleForce {
+class ImpulseRadialForce final : public ParticleForce {
    float magnitude;
    float height = .2;
+   CounterRNG rng = CounterRNG(0, 2);
 public:
    void set(float mag) { magnitude = mag; }
    void setHeight(float h) { height = h; }
+   void setSeed(uint32_t seed) { rng.setSeed(seed); }
    ImpulseRadialForce(float magnitude);
-   void updateForce(Particle *);
+   void updateForce(ParticleRef);
+   void updateForces(ParticleStore &, int begin, int end);
+   bool isThreadSafe() const { return true; }
+
+   void apply(ParticleStore &s, int i) const {
+      float r[4];
+      rng.uniform4(s.id[i], s.frame, r);
+      applyDir(s, i, r[0] * 2 - 1, (r[1] - 0.5) * height, r[2] * 2 - 1);
+   }
+   void applyDir(ParticleStore &s, int i, float x, float y, float z) const {
+      float len = sqrt(x * x + y * y + z * z);
+      if (len > 0) {
+         float scale = magnitude / len;
+         s.fx[i] += x * scale;
+         s.fy[i] += y * scale;
+         s.fz[i] += z * scale;
+      }
+   }
 };
 
-class CyclicForce : public ParticleForce {
+class CyclicForce final : public ParticleForce {
    float magnitude;
 public:
    void set(float mag) { magnitude = mag; }
    CyclicForce(float magnitude);
-   void updateForce(Particle *);
+   void updateForce(ParticleRef);
+   void updateForces(ParticleStore &, int begin, int end);
+   bool isThreadSafe() const { return true; }
+
+   // normalize(position) x (1, 0, 0) normalized is (0, z, -y) / |(y, z)|
+   void apply(ParticleStore &s, int i) const {
+      float y = s.py[i];
+      float z = s.pz[i];
+      float len = sqrt(y * y + z * z);
+      if (len > 0) {
+         float scale = magnitude / len;
+         s.fy[i] += z * scale;
+         s.fz[i] -= y * scale;
+      }
+   }
 };
 
-class MovementForce : public ParticleForce {
+class MovementForce final : public ParticleForce {
 private:
    ofVec3f movement;
 public:
    MovementForce() {};
    MovementForce(const ofVec3f & movement);
-   void updateForce(Particle *);
+   void updateForce(ParticleRef);
+   void updateForces(ParticleStore &, int begin, int end);
+   bool isThreadSafe() const { return true; }
    void set(const ofVec3f &movement) { this->movement = movement; };
-};
\ No newline at end of file
+
+   void apply(ParticleStore &s, int i) const {
+      s.fx[i] += movement.x;
+      s.fy[i] += movement.y;
+      s.fz[i] += movement.z;
+   }
+};
+
+//  A fixed set of forces known at compile time, applied as one force.
+//  All of the forces are applied to a particle before moving to the next,
+//  with no virtual calls, so the compiler can inline and fuse the kernels.
+//
+//     new ForcePipeline<GravityForce, MovementForce>(grav, moveForce)
+//
+//  The pipeline only holds pointers, the forces can still be changed
+//  with their set() functions.
+//
+template <typename... Forces>
+class ForcePipeline final : public ParticleForce {
+public:
+   ForcePipeline(Forces *... f) : forces(f...) {}
+
+   void updateForce(ParticleRef p) {
+      callUpdate(p, std::index_sequence_for<Forces...>());
+   }
+   void updateForces(ParticleStore &s, int begin, int end) {
+      for (int i = begin; i < end; i++)
+         apply(s, i, std::index_sequence_for<Forces...>());
+   }
+   bool isThreadSafe() const {
+      return threadSafe(std::index_sequence_for<Forces...>());
+   }
+
+private:
+   template <size_t... I>
+   bool threadSafe(std::index_sequence<I...>) const {
+      bool safe[] = { true, std::get<I>(forces)->isThreadSafe()... };
+      for (bool b : safe)
+         if (!b) return false;
+      return true;
+   }
+   template <size_t... I>
+   void apply(ParticleStore &s, int i, std::index_sequence<I...>) {
+      int expand[] = { 0, (std::get<I>(forces)->apply(s, i), 0)... };
+      (void)expand;
+   }
+   template <size_t... I>
+   void callUpdate(ParticleRef p, std::index_sequence<I...>) {
+      int expand[] = { 0, (std::get<I>(forces)->updateForce(p), 0)... };
+      (void)expand;
+   }
+
+   std::tuple<Forces *...> forces;
+};
@@ -0,0 +1,144 @@
+
+#include <fstream>
+#include <iomanip>
+#include "Profiler.h"
+
+thread_local int ProfileScope::currentDepth = 0;
+
+Profiler & Profiler::get() {
+	static Profiler profiler;
+	return profiler;
+}
+
+Profiler::Profiler() {
+	startTime = Clock::now();
+	frames.resize(MAX_FRAMES);
+}
+
+// collect the threads' events, close the current frame into the ring
+// buffer and start the next one
+//
+void Profiler::beginFrame() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (int i = 0; i < threads.size(); i++) {
+		Event e;
+		while (threads[i]->queue.pop(e)) current.events.push_back(e);
+		dropped += threads[i]->dropped.exchange(0, std::memory_order_relaxed);
+	}
+	double t = now();
+	if (current.start > 0 || !current.events.empty()) {
+		current.duration = t - current.start;
+		std::swap(frames[head], current);
+		head = (head + 1) % MAX_FRAMES;
+		if (count < MAX_FRAMES) count++;
+	}
+	current.events.clear();      // reuses the storage of the oldest frame
+	current.start = t;
+	current.duration = 0;
+}
+
+// the calling thread's queue, made the first time the thread records
+//
+Profiler::ThreadEvents & Profiler::threadEvents() {
+	static thread_local ThreadEvents *local = NULL;
+	if (local == NULL) {
+		std::lock_guard<std::mutex> lock(mutex);
+		threads.emplace_back(new ThreadEvents());
+		local = threads.back().get();
+		local->thread = (int)threads.size() - 1;
+	}
+	return *local;
+}
+
+void Profiler::record(const char *name, double start, double duration, int depth) {
+	ThreadEvents &t = threadEvents();
+	Event e;
+	e.name = name;
+	e.start = start;
+	e.duration = duration;
+	e.depth = depth;
+	e.thread = t.thread;
+	if (!t.queue.push(e)) t.dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Profiler::draw(float x, float y, float width) const {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (count == 0) {
+		ofSetColor(ofColor::white);
+#ifdef COUNTRYROADS_PROFILE
+		ofDrawBitmapString("profiler: no frames yet", x, y + 12);
+#else
+		ofDrawBitmapString("profiler: off in this build.  To turn it on, define COUNTRYROADS_PROFILE\n"
+			"(PROJECT_DEFINES in config.make, or the IDE's preprocessor definitions)\n"
+			"and rebuild.", x, y + 12);
+#endif
+		return;
+	}
+
+	// total time per marker over all buffered frames, in first seen order
+	//
+	vector<const char *> names;
+	vector<double> totals;
+	double frameTotal = 0;
+	for (int f = 0; f < count; f++) {
+		const Frame &frame = getFrame(f);
+		frameTotal += frame.duration;
+		for (int i = 0; i < frame.events.size(); i++) {
+			const Event &e = frame.events[i];
+			int k = 0;
+			while (k < names.size() && strcmp(names[k], e.name) != 0) k++;
+			if (k == names.size()) {
+				names.push_back(e.name);
+				totals.push_back(0);
+			}
+			totals[k] += e.duration;
+		}
+	}
+
+	const float budget = 1000.0 / 60;      // ms
+	const float rowHeight = 14;
+	float frameMs = frameTotal / count / 1000;
+	ofSetColor(ofColor::white);
+	string str = "frame " + ofToString(frameMs, 2) + " ms (" + ofToString(count) + " frames)";
+	if (dropped > 0) str += ", " + ofToString(dropped) + " events dropped";
+	ofDrawBitmapString(str, x, y + 12);
+	y += rowHeight + 4;
+
+	for (int k = 0; k < names.size(); k++) {
+		float ms = totals[k] / count / 1000;
+		float w = std::min(1.0f, ms / budget) * width;
+		ofSetColor(ms > budget ? ofColor::red : ofColor::steelBlue);
+		ofDrawRectangle(x, y, w, rowHeight - 2);
+		ofSetColor(ofColor::white);
+		ofDrawBitmapString(string(names[k]) + " " + ofToString(ms, 3) + " ms", x + 2, y + 10);
+		y += rowHeight;
+	}
+}
+
+// Chrome trace event format: one complete ("X") event per marker
+//
+bool Profiler::writeChromeTrace(const string &path) const {
+	std::ofstream out(path.c_str());
+	if (!out) {
+		cout << "Can't write trace: " << path << endl;
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	out << std::fixed << std::setprecision(3);
+	out << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (int f = count - 1; f >= 0; f--) {
+		const Frame &frame = getFrame(f);
+		out << (first ? "" : ",\n") << "{\"name\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":0"
+			<< ",\"ts\":" << frame.start << ",\"dur\":" << frame.duration << "}";
+		first = false;
+		for (int i = 0; i < frame.events.size(); i++) {
+			const Event &e = frame.events[i];
+			out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << e.thread
+				<< ",\"ts\":" << e.start << ",\"dur\":" << e.duration << "}";
+		}
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return true;
+}
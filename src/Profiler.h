@@ -0,0 +1,116 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include "ofMain.h"
+#include "SpscQueue.h"
+
+//  Scoped frame profiler.
+//
+//  PROFILE_SCOPE("name") times the rest of the enclosing block, PROFILE_FRAME()
+//  starts a new frame.  Events are kept per frame in a ring buffer of the
+//  last MAX_FRAMES frames; draw() shows the mean time per frame of each
+//  marker as bars and writeChromeTrace() saves the buffer for
+//  chrome://tracing or ui.perfetto.dev.
+//
+//  Every thread records into its own preallocated queue, without locking
+//  or allocating, and beginFrame() moves what they have into the frame.
+//  A thread that fills its queue between two frames drops the rest, the
+//  count shows up in draw().
+//
+//  The markers only exist when compiled with COUNTRYROADS_PROFILE defined
+//  (see Build options in README.md); otherwise they expand to nothing, the
+//  buffer stays empty and draw() says how to turn profiling on.  name must
+//  be a string literal (only the pointer is kept).
+//
+#ifdef COUNTRYROADS_PROFILE
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_FRAME() Profiler::get().beginFrame()
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_FRAME() ((void)0)
+#endif
+
+class Profiler {
+public:
+	static const int MAX_FRAMES = 240;
+	static const unsigned THREAD_EVENTS = 4096;   // per thread and frame
+
+	struct Event {
+		const char *name;
+		double start;       // us since the profiler started
+		double duration;    // us
+		int depth;          // nesting level on its thread
+		int thread;         // small per-thread number, 0 is the first thread seen
+	};
+	struct Frame {
+		double start = 0;
+		double duration = 0;
+		vector<Event> events;
+	};
+
+	static Profiler & get();
+
+	void beginFrame();
+	void record(const char *name, double start, double duration, int depth);
+	int getDropped() const { return dropped; }
+	double now() const {
+		return std::chrono::duration<double, std::micro>(Clock::now() - startTime).count();
+	}
+
+	// completed frames, 0 is the most recent
+	//
+	int getNumFrames() const { return count; }
+	const Frame & getFrame(int age) const { return frames[(head - 1 - age + MAX_FRAMES) % MAX_FRAMES]; }
+
+	// bar per marker, mean ms per frame over the buffer, 16.7 ms = width
+	//
+	void draw(float x, float y, float width) const;
+	bool writeChromeTrace(const string &path) const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+	Profiler();
+
+	// written by one thread, read in beginFrame()
+	//
+	struct ThreadEvents {
+		SpscQueue<Event, THREAD_EVENTS> queue;
+		int thread = 0;
+		std::atomic<int> dropped{ 0 };
+	};
+	ThreadEvents & threadEvents();
+
+	Clock::time_point startTime;
+	vector<Frame> frames;
+	int head = 0;
+	int count = 0;
+	Frame current;
+	int dropped = 0;        // events lost to full queues since startup
+	vector<std::unique_ptr<ThreadEvents>> threads;   // kept after the thread ends
+	mutable std::mutex mutex;
+};
+
+//  Times its own lifetime, see PROFILE_SCOPE
+//
+class ProfileScope {
+public:
+	ProfileScope(const char *name) : name(name) {
+		depth = currentDepth++;
+		start = Profiler::get().now();
+	}
+	~ProfileScope() {
+		Profiler &p = Profiler::get();
+		currentDepth--;
+		p.record(name, start, p.now() - start, depth);
+	}
+
+private:
+	static thread_local int currentDepth;
+	const char *name;
+	double start;
+	int depth;
+};
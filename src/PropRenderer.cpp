@@ -0,0 +1,160 @@
+
+#include "PropRenderer.h"
+#include "Profiler.h"
+#include "AllocTracker.h"
+
+bool PropRenderer::setup(ofxAssimpModelLoader &model) {
+#ifdef TARGET_OPENGLES
+	string shaderPath = "shaders_gles/prop";
+#else
+	string shaderPath = ofIsGLProgrammableRenderer() ? "shaders_gl3/prop" : "shaders/prop";
+#endif
+
+	// the mesh attributes keep the default ofShader locations, the instance
+	// attributes go after them.  Both have to be bound before linking.
+	//
+	if (!shader.setupShaderFromFile(GL_VERTEX_SHADER, shaderPath + ".vert") ||
+		!shader.setupShaderFromFile(GL_FRAGMENT_SHADER, shaderPath + ".frag")) {
+		cout << "Prop Shader: " << shaderPath << " failed to load." << endl;
+		return false;
+	}
+	shader.bindDefaults();
+	shader.bindAttribute(INSTANCE_POSITION, "instancePosition");
+	shader.bindAttribute(INSTANCE_YAW_SCALE, "instanceYawScale");
+	if (!shader.linkProgram()) {
+		cout << "Prop Shader: " << shaderPath << " failed to link." << endl;
+		return false;
+	}
+
+	int n = model.getMeshCount();
+	if (n == 0) {
+		cout << "Prop model has no meshes." << endl;
+		return false;
+	}
+
+	// the fixed function (GL 2.1) context only instances with the ARB
+	// extensions, programmable contexts always can
+	//
+#ifdef TARGET_OPENGLES
+	bInstanced = true;
+#else
+	bInstanced = ofIsGLProgrammableRenderer() ||
+		(ofGLCheckExtension("GL_ARB_instanced_arrays") && ofGLCheckExtension("GL_ARB_draw_instanced"));
+#endif
+	if (!bInstanced) cout << "Prop Renderer: no instancing, drawing one copy at a time." << endl;
+
+	// sized up front, the vbos stay where they are
+	//
+	allocate(1024);
+	parts.resize(n);
+	for (int i = 0; i < n; i++) {
+		ofMesh mesh = model.getMesh(i);
+		Part &part = parts[i];
+		part.vbo.setMesh(mesh, GL_STATIC_DRAW);
+		part.numIndices = mesh.getNumIndices();
+		part.texture = model.getTextureForMesh(i);
+
+		// the mesh sits under its node in the model, like ofxAssimpModelLoader::drawFaces
+		//
+		part.matrix = model.getModelMatrix() * glm::mat4(model.getMeshHelper(i).matrix);
+		if (!bInstanced) continue;
+		part.vbo.setAttributeBuffer(INSTANCE_POSITION, buffer, 3, sizeof(Instance), offsetof(Instance, x));
+		part.vbo.setAttributeBuffer(INSTANCE_YAW_SCALE, buffer, 2, sizeof(Instance), offsetof(Instance, yaw));
+		part.vbo.setAttributeDivisor(INSTANCE_POSITION, 1);
+		part.vbo.setAttributeDivisor(INSTANCE_YAW_SCALE, 1);
+	}
+	return true;
+}
+
+// reallocating keeps the buffer's id, so the vbos stay attached to it
+//
+void PropRenderer::allocate(int n) {
+	capacity = n;
+	buffer.allocate(capacity * sizeof(Instance), GL_STATIC_DRAW);
+}
+
+void PropRenderer::clear() {
+	instances.clear();
+	bDirty = true;
+}
+
+void PropRenderer::add(const ofVec3f &position, float yaw, float scale) {
+	Instance inst;
+	inst.x = position.x;
+	inst.y = position.y;
+	inst.z = position.z;
+	inst.yaw = yaw;
+	inst.scale = scale;
+	instances.push_back(inst);
+	bDirty = true;
+}
+
+void PropRenderer::setInstances(const Instance *p, int n) {
+	instances.assign(p, p + n);
+	bDirty = true;
+}
+
+void PropRenderer::update() {
+	PROFILE_SCOPE("PropRenderer::update");
+	ALLOC_TAG(ALLOC_RENDERER);
+	if (!bDirty) return;
+	bDirty = false;
+
+	// without instancing draw() reads the list itself
+	//
+	if (!bInstanced) {
+		uploaded = (int)instances.size();
+		return;
+	}
+
+	// grow by doubling like the particle buffer
+	//
+	int n = (int)instances.size();
+	if (n > capacity) allocate(std::max(n, capacity * 2));
+	if (n > 0) buffer.updateData(0, n * sizeof(Instance), instances.data());
+	uploaded = n;
+}
+
+void PropRenderer::drawParts() const {
+	if (uploaded == 0) return;
+	shader.begin();
+	shader.setUniform3f("lightDirection", lightDirection.x, lightDirection.y, lightDirection.z);
+	shader.setUniform1f("ambient", ambient);
+	for (int i = 0; i < parts.size(); i++) {
+		const Part &part = parts[i];
+		shader.setUniformMatrix4f("propMatrix", part.matrix);
+		part.texture.bind();
+		if (bInstanced) {
+			part.vbo.drawElementsInstanced(GL_TRIANGLES, part.numIndices, uploaded);
+		}
+		else {
+			// the instance attributes have no buffer here, so each copy
+			// sets them as constants for its draw
+			//
+			for (int k = 0; k < uploaded; k++) {
+				const Instance &inst = instances[k];
+				glVertexAttrib3f(INSTANCE_POSITION, inst.x, inst.y, inst.z);
+				glVertexAttrib2f(INSTANCE_YAW_SCALE, inst.yaw, inst.scale);
+				part.vbo.drawElements(GL_TRIANGLES, part.numIndices);
+			}
+		}
+		part.texture.unbind();
+	}
+	shader.end();
+}
+
+void PropRenderer::draw() const {
+	PROFILE_SCOPE("PropRenderer::draw");
+	drawParts();
+}
+
+void PropRenderer::drawWireframe() const {
+	PROFILE_SCOPE("PropRenderer::draw");
+#ifndef TARGET_OPENGLES
+	glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+	drawParts();
+	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+#else
+	drawParts();
+#endif
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include "ofMain.h"
+#include "ofxAssimpModelLoader.h"
+
+//  Draws many copies of one model (corn stalks) with one instanced draw
+//  call per mesh of the model.
+//
+//  setup() uploads the model's meshes and textures once.  Each copy is an
+//  Instance: a position on the ground, a rotation about the up axis and a
+//  uniform scale.  The instances live in one vertex buffer with an
+//  attribute divisor of 1, and the shader (data/shaders*/prop.vert) builds
+//  the transform from them.  update() uploads the list after it changed.
+//
+//  Without instancing (a GL 2.1 context lacking GL_ARB_instanced_arrays and
+//  GL_ARB_draw_instanced) the same shader draws one copy per draw call,
+//  with the instance attributes set as constants.
+//
+//  The shader does its own directional lighting, ofLight doesn't reach it.
+//  Like the ParticleRenderer it picks shaders_gl3, shaders or shaders_gles
+//  to match the renderer.
+//
+class PropRenderer {
+public:
+	// the model must be at the origin; its own transform (scale
+	// normalization, axis flips) and each mesh's node transform are
+	// applied to every instance
+	//
+	bool setup(ofxAssimpModelLoader &model);
+
+	// 20 bytes per instance, see the attributes in prop.vert
+	//
+	struct Instance {
+		float x, y, z;
+		float yaw;          // radians about +y
+		float scale;
+	};
+
+	void clear();
+	void add(const ofVec3f &position, float yaw = 0, float scale = 1);
+	void setInstances(const Instance *instances, int n);
+	const vector<Instance> & getInstances() const { return instances; }
+	int getCount() const { return (int)instances.size(); }
+
+	// direction towards the light, in world space
+	//
+	void setLightDirection(const ofVec3f &dir) { lightDirection = dir.getNormalized(); }
+	void setAmbient(float a) { ambient = a; }
+
+	// upload the instances if they changed.  Call before draw().
+	//
+	void update();
+
+	// all instances, call between camera begin() and end()
+	//
+	void draw() const;
+	void drawWireframe() const;
+
+	enum Attribute { INSTANCE_POSITION = 4, INSTANCE_YAW_SCALE = 5 };
+
+private:
+	struct Part {
+		ofVbo vbo;
+		ofTexture texture;
+		glm::mat4 matrix;       // model and node transform of the mesh
+		int numIndices = 0;
+	};
+	void allocate(int capacity);
+	void drawParts() const;
+
+	vector<Part> parts;
+	vector<Instance> instances;
+	ofBufferObject buffer;
+	ofShader shader;
+	ofVec3f lightDirection = ofVec3f(0.3, 1, 0.2).getNormalized();
+	float ambient = 0.35;
+	int capacity = 0;
+	int uploaded = 0;
+	bool bDirty = false;
+	bool bInstanced = true;
+};
@@ -0,0 +1,265 @@
+
+#include <thread>
+#include "PropScatter.h"
+#include "Profiler.h"
+#include "AllocTracker.h"
+
+PropScatter::~PropScatter() {
+	wait();
+}
+
+void PropScatter::setup(const TerrainPatches &terrain, const ScatterRule &rule, float chunkSize, JobPool *pool, uint32_t seed) {
+	wait();
+	this->terrain = &terrain;
+	this->rule = rule;
+	this->chunkSize = chunkSize;
+	this->pool = pool;
+	rng = CounterRNG(seed, 4);
+	keepOut.clear();
+
+	const Vector3 &min = terrain.getBounds().parameters[0];
+	const Vector3 &max = terrain.getBounds().parameters[1];
+	origin = ofVec2f(min.x(), min.z());
+	dims[0] = std::max(1, (int)ceil((max.x() - min.x()) / chunkSize));
+	dims[1] = std::max(1, (int)ceil((max.z() - min.z()) / chunkSize));
+	chunks = vector<Chunk>(dims[0] * dims[1]);
+}
+
+// until no chunk job is running, helping with the jobs meanwhile
+//
+void PropScatter::wait() {
+	while (running > 0) {
+		if (pool == NULL || !pool->runOne()) std::this_thread::yield();
+	}
+}
+
+bool PropScatter::isKeptOut(float x, float z) const {
+	for (int i = 0; i < keepOut.size(); i++) {
+		const Vector3 &min = keepOut[i].parameters[0];
+		const Vector3 &max = keepOut[i].parameters[1];
+		if (x >= min.x() && x <= max.x() && z >= min.z() && z <= max.z()) return true;
+	}
+	return false;
+}
+
+int PropScatter::generate(int c, vector<PropRecord> &records, float &yMin, float &yMax) const {
+	PROFILE_SCOPE("PropScatter::generate");
+	ALLOC_TAG(ALLOC_PROPS);
+	records.clear();
+	float x0 = origin.x + (c % dims[0]) * chunkSize;
+	float z0 = origin.y + (c / dims[0]) * chunkSize;
+
+	// one jittered candidate per grid cell, dropped early by the rules
+	// that don't need the terrain
+	//
+	int cells = std::max(1, (int)(chunkSize * sqrt(rule.density) + 0.5f));
+	float cell = chunkSize / cells;
+	vector<ofVec2f> xz;
+	vector<uint8_t> yaw, scale;
+	xz.reserve(cells * cells * 3);
+	for (int k = 0; k < cells; k++) {
+		for (int i = 0; i < cells; i++) {
+			float r[4];
+			rng.uniform4(c, k * cells + i, r);
+			float x = x0 + (i + r[0]) * cell;
+			float z = z0 + (k + r[1]) * cell;
+			if (rule.clusterSize > 0 &&
+				ofNoise(x / rule.clusterSize, z / rule.clusterSize) < rule.clusterCutoff) continue;
+			if (isKeptOut(x, z)) continue;
+
+			// the point and two neighbours for the slope
+			//
+			xz.push_back(ofVec2f(x, z));
+			xz.push_back(ofVec2f(x + rule.slopeStep, z));
+			xz.push_back(ofVec2f(x, z + rule.slopeStep));
+			yaw.push_back(r[2] * 256);
+			scale.push_back(r[3] * 256);
+		}
+	}
+
+	int n = (int)yaw.size();
+	vector<float> heights(n * 3);
+	if (n > 0) terrain->columnHeights(xz.data(), n * 3, heights.data());
+
+	// keep the ones the height and slope rules allow, their heights are
+	// packed into the chunk's range at the end
+	//
+	vector<float> y;
+	y.reserve(n);
+	yMin = FLT_MAX;
+	yMax = -FLT_MAX;
+	for (int j = 0; j < n; j++) {
+		float h = heights[j * 3];
+		float hx = heights[j * 3 + 1];
+		float hz = heights[j * 3 + 2];
+		if (h == -FLT_MAX || hx == -FLT_MAX || hz == -FLT_MAX) continue;
+		if (h < rule.minHeight || h > rule.maxHeight) continue;
+		float slope = sqrt((hx - h) * (hx - h) + (hz - h) * (hz - h)) / rule.slopeStep;
+		if (slope > rule.maxSlope) continue;
+
+		PropRecord p;
+		p.x = ofClamp((xz[j * 3].x - x0) / chunkSize * 65535 + 0.5f, 0, 65535);
+		p.z = ofClamp((xz[j * 3].y - z0) / chunkSize * 65535 + 0.5f, 0, 65535);
+		p.yaw = yaw[j];
+		p.scale = scale[j];
+		records.push_back(p);
+		y.push_back(h);
+		yMin = std::min(yMin, h);
+		yMax = std::max(yMax, h);
+	}
+	if (records.empty()) {
+		yMin = yMax = 0;
+		return 0;
+	}
+	float range = yMax - yMin;
+	for (int j = 0; j < records.size(); j++) {
+		records[j].y = range > 0 ? (uint16_t)((y[j] - yMin) / range * 65535 + 0.5f) : 0;
+	}
+	return (int)records.size();
+}
+
+void PropScatter::queue(int c) {
+	Chunk &chunk = chunks[c];
+	chunk.state = QUEUED;
+	if (pool == NULL) {
+		generate(c, chunk.props, chunk.yMin, chunk.yMax);
+		chunk.state = READY;
+		return;
+	}
+	running++;
+	pool->submit([this, c]() {
+		Chunk &chunk = chunks[c];
+		generate(c, chunk.props, chunk.yMin, chunk.yMax);
+		chunk.state.store(READY, std::memory_order_release);
+		running--;
+	});
+}
+
+// distance in xz from p to the square of chunk c
+//
+float PropScatter::distance(int c, const ofVec3f &p) const {
+	float x0 = origin.x + (c % dims[0]) * chunkSize;
+	float z0 = origin.y + (c / dims[0]) * chunkSize;
+	float dx = std::max({ x0 - p.x, 0.0f, p.x - (x0 + chunkSize) });
+	float dz = std::max({ z0 - p.z, 0.0f, p.z - (z0 + chunkSize) });
+	return sqrt(dx * dx + dz * dz);
+}
+
+void PropScatter::load(const ofVec3f &p, float radius) {
+	PROFILE_SCOPE("PropScatter::load");
+	wait();
+	vector<int> missing;
+	for (int c = 0; c < chunks.size(); c++) {
+		if (chunks[c].state == UNLOADED && distance(c, p) <= radius) missing.push_back(c);
+	}
+	auto fn = [this, &missing](int begin, int end) {
+		for (int i = begin; i < end; i++) {
+			Chunk &chunk = chunks[missing[i]];
+			generate(missing[i], chunk.props, chunk.yMin, chunk.yMax);
+			chunk.state = READY;
+		}
+	};
+	if (pool) pool->parallelFor(0, (int)missing.size(), 1, fn);
+	else fn(0, (int)missing.size());
+	update(p, radius);
+}
+
+bool PropScatter::update(const ofVec3f &p, float radius) {
+	PROFILE_SCOPE("PropScatter::update");
+	bool changed = false;
+	float keep = radius + chunkSize;
+	for (int c = 0; c < chunks.size(); c++) {
+		Chunk &chunk = chunks[c];
+		float d = distance(c, p);
+
+		int state = chunk.state.load(std::memory_order_acquire);
+		if (d <= radius && state == UNLOADED) {
+			queue(c);
+			state = chunk.state.load(std::memory_order_acquire);
+		}
+		if (state == READY && !chunk.bShown && d <= keep) {
+			chunk.bShown = true;
+			changed = true;
+		}
+		else if (state == READY && d > keep) {
+			vector<PropRecord>().swap(chunk.props);
+			chunk.state = UNLOADED;
+			changed |= chunk.bShown;
+			chunk.bShown = false;
+			chunk.bVisible = true;
+		}
+	}
+	return changed;
+}
+
+Box PropScatter::getChunkBox(int c) const {
+	const Chunk &chunk = chunks[c];
+	float pad = rule.propSize * rule.maxScale;
+	float x0 = origin.x + (c % dims[0]) * chunkSize;
+	float z0 = origin.y + (c / dims[0]) * chunkSize;
+	return Box(Vector3(x0 - pad / 2, chunk.yMin, z0 - pad / 2),
+		Vector3(x0 + chunkSize + pad / 2, chunk.yMax + pad, z0 + chunkSize + pad / 2));
+}
+
+bool PropScatter::cull(const OcclusionCuller *culler) {
+	PROFILE_SCOPE("PropScatter::cull");
+	bool changed = false;
+	for (int c = 0; c < chunks.size(); c++) {
+		Chunk &chunk = chunks[c];
+		if (!chunk.bShown) continue;
+		bool visible = culler == NULL || chunk.props.empty() || culler->isVisible(getChunkBox(c));
+		changed |= visible != chunk.bVisible;
+		chunk.bVisible = visible;
+	}
+	return changed;
+}
+
+void PropScatter::getInstances(vector<PropRenderer::Instance> &instances) const {
+	instances.clear();
+	const float turn = TWO_PI / 256;
+	for (int c = 0; c < chunks.size(); c++) {
+		const Chunk &chunk = chunks[c];
+		if (!chunk.bShown || !chunk.bVisible) continue;
+		float x0 = origin.x + (c % dims[0]) * chunkSize;
+		float z0 = origin.y + (c / dims[0]) * chunkSize;
+		float yScale = (chunk.yMax - chunk.yMin) / 65535;
+		for (int i = 0; i < chunk.props.size(); i++) {
+			const PropRecord &p = chunk.props[i];
+			PropRenderer::Instance inst;
+			inst.x = x0 + p.x * chunkSize / 65535;
+			inst.y = chunk.yMin + p.y * yScale;
+			inst.z = z0 + p.z * chunkSize / 65535;
+			inst.yaw = p.yaw * turn;
+			inst.scale = ofLerp(rule.minScale, rule.maxScale, p.scale / 255.0f);
+			instances.push_back(inst);
+		}
+	}
+}
+
+int PropScatter::getNumLoaded() const {
+	int n = 0;
+	for (int c = 0; c < chunks.size(); c++) n += chunks[c].bShown;
+	return n;
+}
+
+int PropScatter::getNumHidden() const {
+	int n = 0;
+	for (int c = 0; c < chunks.size(); c++) n += chunks[c].bShown && !chunks[c].bVisible;
+	return n;
+}
+
+int PropScatter::getNumProps() const {
+	int n = 0;
+	for (int c = 0; c < chunks.size(); c++) {
+		if (chunks[c].bShown) n += (int)chunks[c].props.size();
+	}
+	return n;
+}
+
+size_t PropScatter::getMemoryUsage() const {
+	size_t bytes = chunks.size() * sizeof(Chunk);
+	for (int c = 0; c < chunks.size(); c++) {
+		if (chunks[c].bShown) bytes += chunks[c].props.capacity() * sizeof(PropRecord);
+	}
+	return bytes;
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <cfloat>
+#include "ofMain.h"
+#include "TerrainPatches.h"
+#include "JobPool.h"
+#include "PropRenderer.h"
+#include "OcclusionCuller.h"
+#include "Random.h"
+
+//  Procedural placement of props (corn stalks) over the terrain.
+//
+//  The xz extent of the terrain is split into square chunks.  A chunk is
+//  filled by jittered grid sampling at the rule's density; the candidates
+//  get their heights from one batched TerrainPatches::columnHeights() call
+//  and are kept where the height, slope and cluster rules allow.  Placement
+//  only depends on the seed and the chunk, so a chunk can be dropped and
+//  made again later with the same result.
+//
+//  Every prop is stored as an 8 byte PropRecord relative to its chunk.
+//  update() keeps the chunks within a radius of the camera loaded,
+//  generating missing ones as jobs on a JobPool, and frees the ones that
+//  fell out of range.  cull() hides the loaded chunks an OcclusionCuller
+//  can't see, and getInstances() expands the rest for the PropRenderer.
+//
+struct ScatterRule {
+	float density = 0.02;        // props per square unit, before the other rules
+	float minHeight = -FLT_MAX;
+	float maxHeight = FLT_MAX;
+	float maxSlope = 0.6;        // rise over run
+	float slopeStep = 2;         // distance of the slope samples
+	float clusterSize = 60;      // size of the noise patches, 0 = no patches
+	float clusterCutoff = 0.4;   // noise (0 - 1) below this grows nothing
+	float minScale = 0.8;
+	float maxScale = 1.2;
+	float propSize = 3;          // height of a prop at scale 1, pads the chunk bounds
+};
+
+struct PropRecord {
+	uint16_t x, z;      // position in the chunk, 0 .. 65535 over chunkSize
+	uint16_t y;         // height, 0 .. 65535 over the chunk's yMin .. yMax
+	uint8_t yaw;        // 256 steps per turn
+	uint8_t scale;      // 0 .. 255 over minScale .. maxScale
+};
+
+class PropScatter {
+public:
+	~PropScatter();
+
+	// terrain must stay put while the scatter is in use.  Chunks are
+	// generated as jobs on pool; with NULL, update() generates them itself.
+	//
+	void setup(const TerrainPatches &terrain, const ScatterRule &rule, float chunkSize, JobPool *pool, uint32_t seed = 0);
+
+	// no props inside the xz extent of the box (landing pads)
+	//
+	void addKeepOut(const Box &box) { keepOut.push_back(box); }
+
+	// load the chunks within radius of p (in xz) and free the ones further
+	// than radius + chunkSize.  Missing chunks are queued on the pool and
+	// show up in a later update().  True when the set of loaded chunks
+	// changed.
+	//
+	bool update(const ofVec3f &p, float radius);
+
+	// generate the missing chunks within radius of p now, in parallel on
+	// the pool, and load them.  For load time, so the field around the
+	// start doesn't pop in.
+	//
+	void load(const ofVec3f &p, float radius);
+
+	// test the loaded chunks against culler (NULL shows them all).  True
+	// when a chunk was hidden or shown.
+	//
+	bool cull(const OcclusionCuller *culler);
+
+	void getInstances(vector<PropRenderer::Instance> &instances) const;
+
+	// bounds of chunk c and its props, valid while it is loaded
+	//
+	Box getChunkBox(int c) const;
+
+	// props of chunk c, returns their count.  Doesn't touch the loaded chunks.
+	//
+	int generate(int c, vector<PropRecord> &records, float &yMin, float &yMax) const;
+
+	int getNumChunks() const { return (int)chunks.size(); }
+	int getNumLoaded() const;
+	int getNumHidden() const;
+	int getNumProps() const;
+	size_t getMemoryUsage() const;
+
+private:
+	enum State { UNLOADED, QUEUED, READY };
+	struct Chunk {
+		std::atomic<int> state{ UNLOADED };
+		bool bShown = false;      // READY and counted in getInstances()
+		bool bVisible = true;     // not hidden by cull()
+		float yMin = 0;
+		float yMax = 0;
+		vector<PropRecord> props;
+	};
+	void queue(int c);
+	void wait();
+	float distance(int c, const ofVec3f &p) const;
+	bool isKeptOut(float x, float z) const;
+
+	const TerrainPatches *terrain = NULL;
+	ScatterRule rule;
+	vector<Box> keepOut;
+	JobPool *pool = NULL;
+	CounterRNG rng;
+	float chunkSize = 32;
+	ofVec2f origin;          // min xz corner of chunk 0
+	int dims[2] = { 0, 0 };  // chunks in x and z
+	vector<Chunk> chunks;
+	std::atomic<int> running{ 0 };
+};
@@ -0,0 +1,90 @@
+#pragma once
+#include <stdint.h>
+
+//  Counter based random numbers (Philox4x32-10, Salmon et al. "Parallel
+//  Random Numbers: As Easy as 1, 2, 3", SC 2011).
+//
+//  There is no state to advance: the numbers are a pure function of the
+//  key (seed, stream) and a counter, so any thread can generate the numbers
+//  for particle "id" at frame "frame" and always get the same ones.
+//
+//  The stream tells apart the kinds of users: 1 TurbulenceForce,
+//  2 ImpulseRadialForce, 3 ParticleEmitter, 4 PropScatter.  The seed tells
+//  apart users of the same kind, see Simulation::Seed.
+//
+class CounterRNG {
+public:
+	CounterRNG(uint32_t seed = 0, uint32_t stream = 0) : seed(seed), stream(stream) {}
+	void setSeed(uint32_t s) { seed = s; }
+	void setStream(uint32_t s) { stream = s; }
+	uint32_t getSeed() const { return seed; }
+
+	// four uniform floats in [0, 1) for counter (a, b)
+	//
+	void uniform4(uint32_t a, uint32_t b, float out[4]) const {
+		uint32_t c[4] = { a, b, 0, 0 };
+		philox(c, seed, stream);
+		for (int i = 0; i < 4; i++)
+			out[i] = toFloat(c[i]);
+	}
+
+	float uniform(uint32_t a, uint32_t b, float min, float max) const {
+		float r[4];
+		uniform4(a, b, r);
+		return min + (max - min) * r[0];
+	}
+
+	// batch version for counters (a[i], b), i = 0..n-1.  Written lane by
+	// lane over plain arrays so the compiler can vectorize it.
+	//
+	void fill(const uint32_t *a, uint32_t b, int n, float *r0, float *r1, float *r2, float *r3) const {
+		for (int i = 0; i < n; i++) {
+			uint32_t c0 = a[i], c1 = b, c2 = 0, c3 = 0;
+			uint32_t k0 = seed, k1 = stream;
+			for (int r = 0; r < 10; r++) {
+				uint64_t p0 = (uint64_t)M0 * c0;
+				uint64_t p1 = (uint64_t)M1 * c2;
+				uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+				uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+				c1 = (uint32_t)p1;
+				c3 = (uint32_t)p0;
+				c0 = n0;
+				c2 = n2;
+				k0 += W0;
+				k1 += W1;
+			}
+			r0[i] = toFloat(c0);
+			r1[i] = toFloat(c1);
+			r2[i] = toFloat(c2);
+			r3[i] = toFloat(c3);
+		}
+	}
+
+	static void philox(uint32_t c[4], uint32_t k0, uint32_t k1) {
+		for (int r = 0; r < 10; r++) {
+			uint64_t p0 = (uint64_t)M0 * c[0];
+			uint64_t p1 = (uint64_t)M1 * c[2];
+			uint32_t n0 = (uint32_t)(p1 >> 32) ^ c[1] ^ k0;
+			uint32_t n2 = (uint32_t)(p0 >> 32) ^ c[3] ^ k1;
+			c[1] = (uint32_t)p1;
+			c[3] = (uint32_t)p0;
+			c[0] = n0;
+			c[2] = n2;
+			k0 += W0;
+			k1 += W1;
+		}
+	}
+
+	// top 24 bits to a float in [0, 1)
+	//
+	static float toFloat(uint32_t x) { return (x >> 8) * (1.0f / 16777216.0f); }
+
+private:
+	static const uint32_t M0 = 0xD2511F53;
+	static const uint32_t M1 = 0xCD9E8D57;
+	static const uint32_t W0 = 0x9E3779B9;
+	static const uint32_t W1 = 0xBB67AE85;
+
+	uint32_t seed;
+	uint32_t stream;
+};
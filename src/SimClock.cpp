@@ -0,0 +1,30 @@
+
+#include "SimClock.h"
+
+// add real (frame) time and return the number of fixed steps due
+//
+int SimClock::advance(float frameTime) {
+	accumulator += frameTime * timeScale;
+	int n = (int)(accumulator / step);
+	if (n > maxSubsteps) {
+		// drop the time we can't catch up on
+		//
+		n = maxSubsteps;
+		accumulator = n * step;
+	}
+	accumulator -= n * step;
+	return n;
+}
+
+// one fixed step has been simulated
+//
+void SimClock::tick() {
+	time += step;
+	steps++;
+}
+
+void SimClock::reset() {
+	accumulator = 0;
+	time = 0;
+	steps = 0;
+}
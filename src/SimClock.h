@@ -0,0 +1,33 @@
+#pragma once
+#include "ofMain.h"
+
+//  Fixed timestep simulation clock.
+//
+//  Each frame the app passes in the real frame time with advance(), which
+//  returns how many fixed steps to simulate.  The app runs them, calling
+//  tick() after each one.  Left over time carries to the next frame and
+//  getAlpha() gives how far the clock is between the last two steps, for
+//  interpolating what gets drawn.
+//
+class SimClock {
+public:
+	void setStep(float dt) { step = dt; }
+	void setMaxSubsteps(int n) { maxSubsteps = n; }
+	void setTimeScale(float s) { timeScale = s; }
+	int advance(float frameTime);
+	void tick();
+	void reset();
+
+	float getStep() const { return step; }
+	float getTime() const { return (float)time; }       // sec of simulated time
+	uint64_t getStepCount() const { return steps; }
+	float getAlpha() const { return accumulator / step; }
+
+private:
+	float step = 1.0 / 120;
+	int maxSubsteps = 8;       // cap per frame so a long frame can't snowball
+	float timeScale = 1;
+	float accumulator = 0;
+	double time = 0;
+	uint64_t steps = 0;
+};
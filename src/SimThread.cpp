@@ -0,0 +1,112 @@
+
+#include "SimThread.h"
+#include "Profiler.h"
+#include "AllocTracker.h"
+
+void SimThread::start(float step, int maxSubsteps) {
+	if (running) return;
+	clock.setStep(step);
+	clock.setMaxSubsteps(maxSubsteps);
+	bReplaying = replay != NULL;
+	if (replay) replay->rewind();
+
+	// so the first acquire() already has the start position
+	//
+	publish();
+	running = true;
+	thread = std::thread(&SimThread::run, this);
+}
+
+void SimThread::stop() {
+	running = false;
+	if (thread.joinable()) thread.join();
+}
+
+bool SimThread::control(Control c, float value) {
+	ControlEvent e;
+	e.step = 0;         // stamped by the simulation thread
+	e.control = c;
+	e.pad[0] = e.pad[1] = e.pad[2] = 0;
+	e.value = value;
+	return inputs.push(e);
+}
+
+const SimSnapshot & SimThread::acquire() {
+	if (ready.load(std::memory_order_relaxed) & FRESH) {
+		front = ready.exchange(front, std::memory_order_acq_rel) & ~FRESH;
+	}
+	return buffers[front];
+}
+
+float SimThread::getAlpha(const SimSnapshot &s) const {
+	float since = std::chrono::duration<float>(Clock::now() - s.published).count();
+	return ofClamp(s.alpha + since / clock.getStep(), 0, 1);
+}
+
+// pilot controls are ignored while a recording is flown
+//
+void SimThread::apply(ControlEvent &e) {
+	if (bReplaying) return;
+	e.step = (uint32_t)clock.getStepCount();
+	if (recorder) recorder->record(e.step, (Control)e.control, e.value);
+	sim.applyControl(e);
+}
+
+void SimThread::run() {
+	Clock::time_point last = Clock::now();
+	while (running) {
+		Clock::time_point now = Clock::now();
+		float frameTime = std::chrono::duration<float>(now - last).count();
+		last = now;
+
+		ControlEvent e;
+		bool changed = false;
+		while (inputs.pop(e)) {
+			apply(e);
+			changed = true;
+		}
+
+		int steps = clock.advance(paused ? 0 : frameTime);
+		for (int i = 0; i < steps; i++) {
+			if (bReplaying) replay->replay(sim, (uint32_t)clock.getStepCount());
+			clock.tick();
+			sim.step(clock.getStep(), clock.getTime());
+
+			if (bReplaying && clock.getStepCount() >= replay->steps) {
+				bReplaying = false;
+				cout << "Replay finished, trajectory "
+					<< (sim.trajectoryHash == replay->hash ? "matches" : "differs from") << " the recording" << endl;
+			}
+		}
+		if (steps > 0 || changed) publish();
+
+		// sleep until the next step is due
+		//
+		float wait = paused ? clock.getStep() : (1 - clock.getAlpha()) * clock.getStep();
+		std::this_thread::sleep_for(std::chrono::duration<float>(wait));
+	}
+}
+
+void SimThread::publish() {
+	PROFILE_SCOPE("SimThread::publish");
+	ALLOC_TAG(ALLOC_SNAPSHOT);
+	SimSnapshot &s = buffers[back];
+	s.step = clock.getStepCount();
+	s.time = clock.getTime();
+	s.alpha = clock.getAlpha();
+	s.published = Clock::now();
+	s.currentPos = sim.currentPos;
+	s.previousPos = sim.previousPos;
+	s.shipBox = sim.shipBox;
+	s.altitude = sim.altitude;
+	s.bCollide = sim.bCollide;
+	s.bLanded = sim.bLanded;
+	s.bThrust = sim.bThrust;
+	s.bPointSelected = sim.bPointSelected;
+	s.selectedPoint = sim.selectedPoint;
+	s.bReplaying = bReplaying;
+	s.thrust.copy(sim.thrusterEmitter.sys->particles, s.time);
+	s.corn.copy(sim.cornEmitter.sys->particles, s.time);
+
+	back = ready.exchange(back | FRESH, std::memory_order_acq_rel) & ~FRESH;
+}
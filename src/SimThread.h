@@ -0,0 +1,102 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "ofMain.h"
+#include "Simulation.h"
+#include "SimClock.h"
+#include "SpscQueue.h"
+#include "InputRecorder.h"
+
+//  What the render thread gets to see of one simulation step.  Everything
+//  is copied, so a snapshot never changes while it is being drawn.
+//
+struct SimSnapshot {
+	uint64_t step = 0;
+	float time = 0;             // simulated sec
+	float alpha = 0;            // how far the clock was past this step, 0 - 1
+	std::chrono::steady_clock::time_point published;
+
+	ofVec3f currentPos;
+	ofVec3f previousPos;
+	Box shipBox;
+	float altitude = 0;
+	bool bCollide = false;
+	bool bLanded = false;
+	bool bThrust = false;
+	bool bPointSelected = false;
+	ofVec3f selectedPoint;
+	bool bReplaying = false;
+
+	ParticleSnapshot thrust;
+	ParticleSnapshot corn;
+};
+
+//  Runs a Simulation on its own thread at a fixed step, so a slow frame
+//  doesn't slow the physics down (or the other way around).
+//
+//  After each batch of steps the simulation thread writes a SimSnapshot into
+//  one of three buffers and publishes it with an atomic exchange; the render
+//  thread takes the latest one with acquire(), also with an exchange.  No
+//  locks, and neither side ever waits for the other.  Controls go the other
+//  way over a lock free queue and are applied before the next step.
+//
+//  The Simulation must not be touched by anyone else between start() and
+//  stop(), except for data that doesn't change after setup (the octree, the
+//  landing areas).
+//
+class SimThread {
+public:
+	SimThread(Simulation &sim) : sim(sim) {}
+	~SimThread() { stop(); }
+
+	void start(float step, int maxSubsteps = 8);
+	void stop();
+	void setPaused(bool p) { paused = p; }
+
+	// from the render thread.  false if the queue is full (the control is lost)
+	//
+	bool control(Control c, float value);
+
+	// latest snapshot, stays valid until the next call
+	//
+	const SimSnapshot & acquire();
+
+	// how far past s the simulation is now, for interpolating s.previousPos
+	// to s.currentPos
+	//
+	float getAlpha(const SimSnapshot &s) const;
+	float getStep() const { return clock.getStep(); }
+
+	// Set before start(): recorder gets every pilot control, replay is
+	// flown instead of the pilot until it runs out.  Read them after stop().
+	//
+	InputRecorder *recorder = NULL;
+	InputRecorder *replay = NULL;
+	uint64_t getStepCount() const { return clock.getStepCount(); }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+	static const int FRESH = 4;     // set in ready when it hasn't been acquired yet
+
+	void run();
+	void apply(ControlEvent &e);
+	void publish();
+
+	Simulation &sim;
+	SimClock clock;
+	std::thread thread;
+	std::atomic<bool> running{ false };
+	std::atomic<bool> paused{ false };
+	bool bReplaying = false;
+
+	SpscQueue<ControlEvent, 256> inputs;
+
+	// triple buffer: the simulation writes back, the renderer reads front and
+	// ready is the latest complete one (plus FRESH)
+	//
+	SimSnapshot buffers[3];
+	int back = 0;
+	int front = 1;
+	std::atomic<int> ready{ 2 };
+};
@@ -0,0 +1,420 @@
+#include "Simulation.h"
+#include "Profiler.h"
+#include "AllocTracker.h"
+#include "FrameArena.h"
+
+Simulation::Simulation() {
+
+   // Particles & Physics Setup
+   sys = new ParticleSystem();
+   sys->setCapacity(1);    // just the ship
+   grav = new GravityForce(ofVec3f(0, -1, 0));
+   moveForce = new MovementForce();
+   turb = new TurbulenceForce(ofVec3f(-1, 0, -1), ofVec3f(1, 0, 1));
+
+   // Random numbers are keyed on (seed, stream): the stream is the kind of
+   // source (see Random.h) and the seed the system it belongs to, 0 for
+   // the ship, 1 thrust and 2 harvest.  Otherwise both emitters and both
+   // impulse forces would draw the same numbers for the same particle ids.
+   turb->setSeed(SEED_SHIP);
+
+   // Ship forces are fixed, so apply them as one fused pipeline
+   sys->addForce(new ForcePipeline<GravityForce, MovementForce, TurbulenceForce>(grav, moveForce, turb));
+
+   // Thruster Setup
+   radialForce = new ImpulseRadialForce(1000);
+   radialForce->setHeight(0.2);
+   radialForce->setSeed(SEED_THRUST);
+   cyclicForce = new CyclicForce(500);
+
+   thrusterEmitter.sys->addForce(new ForcePipeline<ImpulseRadialForce, CyclicForce>(radialForce, cyclicForce));
+   thrusterEmitter.setVelocity(ofVec3f(0, -100, 0));
+   thrusterEmitter.setEmitterType(DirectionalEmitter);
+   thrusterEmitter.setGroupSize(200);
+   thrusterEmitter.setRandomLife(true);
+   thrusterEmitter.setLifespanRange(ofVec2f(0.05, 0.1));
+   thrusterEmitter.setRate(20);
+   thrusterEmitter.setSeed(SEED_THRUST);
+   thrusterEmitter.sys->setCapacity(thrusterEmitter.getPeakCount());
+   thrusterEmitter.sys->setJobPool(&jobs, PARALLEL_PARTICLES, PARALLEL_CHUNK);
+
+   radialCorn = new ImpulseRadialForce(1000);
+   radialCorn->setHeight(0.2);
+   radialCorn->setSeed(SEED_HARVEST);
+   cyclicCorn = new CyclicForce(5);
+
+   cornEmitter.sys->addForce(new ForcePipeline<ImpulseRadialForce, CyclicForce>(radialCorn, cyclicCorn));
+   cornEmitter.setVelocity(ofVec3f(0, 0, 0));
+   cornEmitter.setEmitterType(RadialEmitter);
+   cornEmitter.setGroupSize(200);
+   cornEmitter.setRandomLife(true);
+   cornEmitter.setLifespanRange(ofVec2f(0.1, 0.3));
+   cornEmitter.setRate(20);
+   cornEmitter.setSeed(SEED_HARVEST);
+   cornEmitter.sys->setCapacity(cornEmitter.getPeakCount());
+   cornEmitter.sys->setJobPool(&jobs, PARALLEL_PARTICLES, PARALLEL_CHUNK);
+
+   // Landing Fields
+   landings.push_back(Box(Vector3(-172, 16, 134), Vector3(-146, 18, 144)));
+   landings.push_back(Box(Vector3(110, 19, 91), Vector3(155, 21, 113)));
+   landings.push_back(Box(Vector3(170, 19, -165), Vector3(180, 21, -145)));
+
+   altitude = 0;
+   bThrust = false;
+   gravity = 1;
+   bCollide = false;
+   bLanded = false;
+   bPointSelected = false;
+   numLevels = 9;
+   octreeTime = 0;
+   sdfTime = 0;
+
+   const char *names[NUM_STAGES] = { "ship", "thrust", "corn", "collision", "altitude" };
+   for (int i = 0; i < NUM_STAGES; i++)
+      timings[i].name = names[i];
+   steps = 0;
+   trajectoryHash = 14695981039346656037ULL;
+
+   stepDt = 0;
+   stepTime = 0;
+   bParallelStages = true;
+   buildStages();
+}
+
+Simulation::~Simulation() {
+   ParticleSystem *systems[] = { sys, thrusterEmitter.sys, cornEmitter.sys };
+   for (ParticleSystem *s : systems) {
+      for (int i = 0; i < s->forces.size(); i++)
+         delete s->forces[i];
+   }
+   delete grav;
+   delete moveForce;
+   delete turb;
+   delete radialForce;
+   delete cyclicForce;
+   delete radialCorn;
+   delete cyclicCorn;
+   delete sys;
+}
+
+void Simulation::setup(const ofMesh &terrain, const ofVec3f &shipMin, const ofVec3f &shipMax) {
+   this->shipMin = shipMin;
+   this->shipMax = shipMax;
+
+   // Octree
+   cout << "Generating Octree with " << numLevels << " levels." << endl;
+   float startTime = ofGetElapsedTimeMillis();
+   oct.create(terrain, numLevels);
+   octreeTime = ofGetElapsedTimeMillis() - startTime;
+   cout << "Octree Creation Time: " << octreeTime << " ms" << endl;
+
+   // Terrain SDF, built from the octree leaves
+   startTime = ofGetElapsedTimeMillis();
+   sdf.create(oct, 1.0, 4.0);
+   sdfTime = ofGetElapsedTimeMillis() - startTime;
+   cout << "SDF Creation Time: " << sdfTime << " ms" << endl;
+
+   ship.position = ofVec3f(0, 30, 0);
+   ship.velocity = ofVec3f(0, 0);
+   ship.radius = 1;
+   ship.damping = 0.9995;
+
+   sys->add(ship);
+   sys->setLifespan(10000000);
+
+   reset();
+}
+
+// put the ship back at the start
+//
+void Simulation::reset() {
+   sys->particles[0].position = glm::vec3(0, 30, 0);
+   sys->particles[0].velocity = glm::vec3(0, 0, 0);
+   currentPos = previousPos = glm::vec3(0, 30, 0);
+}
+
+// The stages of a step and what they touch:
+//
+//   ship       ship particle, currentPos, shipBox
+//   thrust     thruster emitter and its particles
+//   corn       harvest emitter and its particles, starts it on landing
+//   follow     moves both emitters to the ship
+//   collision  pushes the ship out of the terrain, lands, stops harvesting
+//   altitude   ray down from currentPos
+//
+//   ship, thrust and corn only use their own data, so they run together.
+//   follow waits for all three (the emitters spawn at their old position),
+//   collision for ship and corn, altitude for ship.
+//
+void Simulation::buildStages() {
+   addStage(STAGE_SHIP, &Simulation::updateShip);
+   addStage(STAGE_THRUST, &Simulation::updateThrust);
+   addStage(STAGE_CORN, &Simulation::updateCorn);
+   addStage(STAGE_COLLISION, &Simulation::checkCollision);
+   addStage(STAGE_ALTITUDE, &Simulation::checkAltitude);
+
+   int follow = stages.add("follow", [this]() { followShip(); });
+   stages.depend(follow, stageIds[STAGE_SHIP]);
+   stages.depend(follow, stageIds[STAGE_THRUST]);
+   stages.depend(follow, stageIds[STAGE_CORN]);
+   stages.depend(stageIds[STAGE_COLLISION], stageIds[STAGE_SHIP]);
+   stages.depend(stageIds[STAGE_COLLISION], stageIds[STAGE_CORN]);
+   stages.depend(stageIds[STAGE_ALTITUDE], stageIds[STAGE_SHIP]);
+}
+
+// each stage keeps its own timing, so the stages don't share anything
+//
+void Simulation::addStage(Stage s, void (Simulation::*fn)()) {
+   stageIds[s] = stages.add(timings[s].name.c_str(), [this, s, fn]() {
+      Clock::time_point start = Clock::now();
+      (this->*fn)();
+      timings[s].add(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+   });
+}
+
+// One fixed step of the simulation, dt seconds ending at "time"
+//
+void Simulation::step(float dt, float time) {
+   PROFILE_SCOPE("Simulation::step");
+   previousPos = currentPos;
+   stepDt = dt;
+   stepTime = time;
+   stages.run(bParallelStages ? &jobs : NULL);
+   steps++;
+   hashShip();
+
+   // scratch memory of this step goes back in one go
+   FrameArena::local().reset();
+}
+
+void Simulation::updateShip() {
+   sys->update(stepDt, stepTime);
+   currentPos = sys->particles[0].position;
+
+   // Create Ship Bounding Box
+   ofVec3f min = shipMin + currentPos;
+   ofVec3f max = shipMax + currentPos;
+   shipBox = Box(min, max);
+}
+
+void Simulation::updateThrust() {
+   thrusterEmitter.update(stepDt, stepTime);
+}
+
+void Simulation::updateCorn() {
+   cornEmitter.update(stepDt, stepTime);
+   if (bLanded && !cornEmitter.started) {
+      cornEmitter.start();
+   }
+}
+
+void Simulation::followShip() {
+   thrusterEmitter.setPosition(currentPos);
+   cornEmitter.setPosition(currentPos);
+}
+
+void Simulation::hashShip() {
+   const ParticleStore &s = sys->particles;
+   float v[6] = { s.px[0], s.py[0], s.pz[0], s.vx[0], s.vy[0], s.vz[0] };
+   const uint8_t *bytes = (const uint8_t *)v;
+   for (int i = 0; i < sizeof(v); i++) {
+      trajectoryHash ^= bytes[i];
+      trajectoryHash *= 1099511628211ULL;
+   }
+}
+
+// Pilot input.  Thrust pushes the ship with the move force and starts the
+// exhaust going the other way; release stops both.
+//
+void Simulation::applyControl(const ControlEvent &e) {
+   float move = e.value;
+   switch (e.control) {
+   case CONTROL_FORWARD:
+      thrust(ofVec3f(0, 0, -move), ofVec3f(0, 0, 100));
+      break;
+   case CONTROL_BACK:
+      thrust(ofVec3f(0, 0, move), ofVec3f(0, 0, -100));
+      break;
+   case CONTROL_LEFT:
+      thrust(ofVec3f(-move, 0, 0), ofVec3f(100, 0, 0));
+      break;
+   case CONTROL_RIGHT:
+      thrust(ofVec3f(move, 0, 0), ofVec3f(-100, 0, 0));
+      break;
+   case CONTROL_DOWN:
+      thrust(ofVec3f(0, -move, 0), ofVec3f(0, 100, 0));
+      break;
+   case CONTROL_UP:
+      thrust(ofVec3f(0, move, 0), ofVec3f(0, -100, 0));
+      break;
+   case CONTROL_RELEASE:
+      moveForce->set(ofVec3f(0, 0, 0));
+      bThrust = false;
+      thrusterEmitter.stop();
+      break;
+   case CONTROL_GRAVITY:
+      gravity = e.value;
+      grav->set(ofVec3f(0, -gravity, 0));
+      break;
+   case CONTROL_RESET:
+      reset();
+      break;
+   default:
+      break;
+   }
+}
+
+void Simulation::thrust(const ofVec3f &force, const ofVec3f &exhaust) {
+   moveForce->set(force);
+   if (!bThrust) {
+      bThrust = true;
+      thrusterEmitter.setVelocity(exhaust);
+      thrusterEmitter.start();
+   }
+}
+
+// Check terrain collision using the terrain SDF and ship bounding box
+void Simulation::checkCollision() {
+   PROFILE_SCOPE("Simulation::checkCollision");
+   ALLOC_TAG(ALLOC_OCTREE);
+   ofVec3f vel = sys->particles[0].velocity;
+   if (vel.y > 0) {
+      bCollide = false;
+      bLanded = false;
+
+      // Stop harvesting corn when moving up
+      if (vel.y > 0.5 && cornEmitter.started)
+         cornEmitter.stop();
+
+      return;
+   }
+
+   // Get bounding box corners
+   const Vector3 &min = shipBox.parameters[0];
+   const Vector3 &max = shipBox.parameters[1];
+   ofVec3f points[4] = {
+      ofVec3f(min.x(), min.y(), min.z()),
+      ofVec3f(max.x(), min.y(), max.z()),
+      ofVec3f(min.x(), min.y(), max.z()),
+      ofVec3f(max.x(), min.y(), min.z())
+   };
+
+   // Find the deepest penetrating corner
+   float depth = 0;
+   ofVec3f normal;
+   for (int i = 0; i < 4; i++) {
+      if (sdf.isCreated()) {
+         ofVec3f n;
+         float d = sdf.sample(points[i], n);
+         if (d < depth) {
+            depth = d;
+            normal = n;
+         }
+      }
+      else {
+         // No SDF, fall back to the octree point test
+         const TreeNode *node;
+         if (oct.intersect(points[i], oct.root, node)) {
+            depth = -0.001;
+            normal = ofVec3f(0, 1, 0);
+            break;
+         }
+      }
+   }
+
+   if (depth >= 0) {
+      bCollide = false;
+      return;
+   }
+
+   bCollide = true;
+
+   // Push the ship out of the terrain along the surface normal and
+   // reflect the velocity component going into it.
+   //
+   const float restitution = 0.5;
+   const float friction = 0.5;
+   sys->particles[0].position -= normal * depth;
+   float vn = vel.dot(normal);
+   if (vn < 0) {
+      ofVec3f tangent = vel - normal * vn;
+      sys->particles[0].velocity = tangent * friction - normal * (vn * restitution);
+   }
+
+   // Check if the collision is in a landing area
+   checkLanding();
+}
+
+// Check ship's position with landing areas
+void Simulation::checkLanding() {
+   for (int i = 0; i < landings.size(); i++) {
+      if (landings[i].inside(currentPos)) {
+         bLanded = true;
+         return;
+      }
+   }
+   bLanded = false;
+}
+
+// Check ship altitude using ray intersection
+void Simulation::checkAltitude() {
+   PROFILE_SCOPE("Simulation::checkAltitude");
+   ALLOC_TAG(ALLOC_OCTREE);
+   ofVec3f rayPoint = currentPos + ofVec3f(0, 10, 0);
+   ofVec3f rayDir = ofVec3f(0, -1, 0);    // straight down
+   Ray ray = Ray(rayPoint, rayDir);
+
+   const TreeNode *rtn;
+   if (oct.intersect(ray, oct.root, rtn)) {
+      bPointSelected = true;
+      selectedPoint = rtn->box.center().as<ofVec3f>();
+      altitude = currentPos.y - selectedPoint.y;
+   }
+   else {
+      bPointSelected = false;
+   }
+}
+
+void Simulation::resetTimings() {
+   for (int i = 0; i < NUM_STAGES; i++) {
+      timings[i].total = 0;
+      timings[i].max = 0;
+      timings[i].count = 0;
+   }
+   steps = 0;
+}
+
+// one line per stage: total (ms), mean and max per step (us)
+//
+string Simulation::getTimingReport() const {
+   string str;
+   str += "octree build: " + ofToString(octreeTime, 1) + " ms\n";
+   str += "sdf build:    " + ofToString(sdfTime, 1) + " ms\n";
+   str += "steps:        " + ofToString(steps) + "\n";
+   double total = 0;
+   for (int i = 0; i < NUM_STAGES; i++) {
+      const StageTiming &t = timings[i];
+      str += ofToString(t.name, 10, ' ') + " total " + ofToString(t.total, 3) + " ms";
+      str += "  mean " + ofToString(t.mean() * 1000, 2) + " us";
+      str += "  max " + ofToString(t.max * 1000, 2) + " us\n";
+      total += t.total;
+   }
+   str += "all stages total " + ofToString(total, 3) + " ms\n";
+   return str;
+}
+
+string Simulation::getTimingJson() const {
+   string str = "{\n";
+   str += "  \"octreeBuildMs\": " + ofToString(octreeTime) + ",\n";
+   str += "  \"sdfBuildMs\": " + ofToString(sdfTime) + ",\n";
+   str += "  \"steps\": " + ofToString(steps) + ",\n";
+   str += "  \"stages\": {\n";
+   for (int i = 0; i < NUM_STAGES; i++) {
+      const StageTiming &t = timings[i];
+      str += "    \"" + t.name + "\": { \"totalMs\": " + ofToString(t.total) +
+         ", \"meanMs\": " + ofToString(t.mean()) + ", \"maxMs\": " + ofToString(t.max) + " }";
+      str += (i + 1 < NUM_STAGES) ? ",\n" : "\n";
+   }
+   str += "  }\n}\n";
+   return str;
+}
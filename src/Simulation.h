@@ -0,0 +1,161 @@
+#pragma once
+
+#include <chrono>
+#include "ofMain.h"
+#include "ParticleSystem.h"
+#include "ParticleEmitter.h"
+#include "Particle.h"
+#include "box.h"
+#include "Octree.h"
+#include "TerrainSDF.h"
+#include "JobPool.h"
+#include "TaskGraph.h"
+
+//  Time spent in one stage of the simulation step
+//
+struct StageTiming {
+	string name;
+	double total = 0;   // ms
+	double max = 0;     // ms
+	int count = 0;
+
+	void add(double ms) {
+		total += ms;
+		max = std::max(max, ms);
+		count++;
+	}
+	double mean() const { return count > 0 ? total / count : 0; }
+};
+
+//  Pilot controls.  Everything that steers the ship goes through
+//  Simulation::applyControl() as one of these, so a run can be recorded and
+//  replayed step for step (see InputRecorder.h).  value is the move force
+//  for the thrust controls and the gravity for CONTROL_GRAVITY.
+//
+enum Control {
+	CONTROL_FORWARD,
+	CONTROL_BACK,
+	CONTROL_LEFT,
+	CONTROL_RIGHT,
+	CONTROL_DOWN,
+	CONTROL_UP,
+	CONTROL_RELEASE,
+	CONTROL_GRAVITY,
+	CONTROL_RESET,
+	NUM_CONTROLS
+};
+
+struct ControlEvent {
+	uint32_t step;      // applied before this simulation step (0 is the first)
+	uint8_t control;    // Control
+	uint8_t pad[3];
+	float value;
+};
+
+//  Everything that moves: the ship, its thruster and harvest emitters, the
+//  terrain octree and SDF, and the collision, landing and altitude checks.
+//
+//  Nothing here needs a window or a GL context, so the same simulation runs
+//  in the app and headless (see Headless.h).  The app only adds models,
+//  sound, cameras and drawing on top.
+//
+class Simulation {
+public:
+	enum Stage { STAGE_SHIP, STAGE_THRUST, STAGE_CORN, STAGE_COLLISION, STAGE_ALTITUDE, NUM_STAGES };
+	enum Seed { SEED_SHIP, SEED_THRUST, SEED_HARVEST };    // CounterRNG seed per system
+
+	Simulation();
+	~Simulation();
+
+	// build the octree and SDF from the terrain and set up the ship and
+	// emitters.  shipMin/shipMax is the ship model's bounding box.
+	//
+	void setup(const ofMesh &terrain, const ofVec3f &shipMin, const ofVec3f &shipMax);
+
+	// one fixed step, dt seconds ending at "time"
+	//
+	void step(float dt, float time);
+	void reset();
+	void applyControl(const ControlEvent &e);
+
+	void checkCollision();
+	void checkLanding();
+	void checkAltitude();
+
+	void resetTimings();
+	string getTimingReport() const;
+	string getTimingJson() const;
+
+	// Particle System
+	ParticleSystem *sys;
+	GravityForce *grav;
+	MovementForce *moveForce;
+	TurbulenceForce *turb;
+	Particle ship;
+
+	// Worker threads for the step stages and large particle systems.
+	// bParallelStages false runs the stages one after the other.
+	// The emitter systems hold up to 800 (thrust) and 1600 (harvest)
+	// particles, far below the ParticleSystem defaults, so they split into
+	// chunks of 256 from 512 particles on.
+	static const int PARALLEL_PARTICLES = 512;
+	static const int PARALLEL_CHUNK = 256;
+	JobPool jobs;
+	TaskGraph stages;
+	bool bParallelStages;
+
+	ParticleEmitter thrusterEmitter;
+	ImpulseRadialForce *radialForce;
+	CyclicForce *cyclicForce;
+
+	ParticleEmitter cornEmitter;
+	ImpulseRadialForce *radialCorn;
+	CyclicForce *cyclicCorn;
+
+	// Ship
+	ofVec3f shipMin, shipMax;   // model bounds relative to the ship position
+	Box shipBox;
+	float altitude;
+	ofVec3f currentPos;     // ship position at the last simulation step
+	ofVec3f previousPos;    // ship position at the step before
+	bool bThrust;
+	float gravity;
+	bool bCollide;
+	bool bLanded;
+	bool bPointSelected;
+	ofVec3f selectedPoint;
+
+	// Landing Areas
+	vector<Box> landings;
+
+	// Octree
+	Octree oct;
+	int numLevels;
+	float octreeTime;   // ms
+	float sdfTime;      // ms
+
+	// Terrain distance field for collision response
+	TerrainSDF sdf;
+
+	StageTiming timings[NUM_STAGES];
+	int steps;
+
+	// FNV-1a over the ship position and velocity after every step.  Equal
+	// hashes mean identical trajectories.
+	//
+	uint64_t trajectoryHash;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+	void thrust(const ofVec3f &force, const ofVec3f &exhaust);
+	void hashShip();
+	void buildStages();
+	void addStage(Stage s, void (Simulation::*fn)());
+	void updateShip();
+	void updateThrust();
+	void updateCorn();
+	void followShip();
+
+	float stepDt, stepTime;     // of the step being run, for the stages
+	int stageIds[NUM_STAGES];
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+
+//  Lock free single producer, single consumer ring buffer of N (a power of
+//  two) items.  push() may only be called from one thread and pop() from
+//  one other thread.
+//
+template <typename T, unsigned N>
+class SpscQueue {
+public:
+	static_assert(N > 0 && (N & (N - 1)) == 0, "N must be a power of two");
+
+	// false if the queue is full
+	//
+	bool push(const T &item) {
+		unsigned t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == N) return false;
+		items[t & (N - 1)] = item;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	// false if the queue is empty
+	//
+	bool pop(T &item) {
+		unsigned h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return false;
+		item = items[h & (N - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	T items[N];
+	std::atomic<unsigned> head{ 0 };     // next to pop, written by the consumer
+	std::atomic<unsigned> tail{ 0 };     // next to push, written by the producer
+};
@@ -0,0 +1,88 @@
+
+#include "TaskGraph.h"
+#include "ofMain.h"
+
+int TaskGraph::add(const char *name, Task fn) {
+	Node node;
+	node.name = name;
+	node.fn = std::move(fn);
+	tasks.push_back(std::move(node));
+	order.clear();
+	return (int)tasks.size() - 1;
+}
+
+void TaskGraph::depend(int task, int on) {
+	tasks[on].successors.push_back(task);
+	tasks[task].numDeps++;
+	order.clear();
+}
+
+void TaskGraph::clear() {
+	tasks.clear();
+	order.clear();
+	waiting.reset();
+}
+
+// Kahn's algorithm, false if there is a cycle
+//
+bool TaskGraph::sort() {
+	int n = (int)tasks.size();
+	vector<int> deps(n);
+	order.clear();
+	for (int i = 0; i < n; i++) {
+		deps[i] = tasks[i].numDeps;
+		if (deps[i] == 0) order.push_back(i);
+	}
+	for (int k = 0; k < order.size(); k++) {
+		for (int s : tasks[order[k]].successors) {
+			if (--deps[s] == 0) order.push_back(s);
+		}
+	}
+	if (order.size() != n) {
+		cout << "TaskGraph: dependency cycle, " << n - order.size() << " tasks can't run" << endl;
+		order.clear();
+		return false;
+	}
+	waiting.reset(new std::atomic<int>[n]);
+	return true;
+}
+
+// run a task, then submit the successors it was the last dependency of.
+// The jobs capture [this, task] only, which std::function stores without
+// allocating.
+//
+void TaskGraph::runTask(int task) {
+	tasks[task].fn();
+	for (int s : tasks[task].successors) {
+		if (waiting[s].fetch_sub(1) == 1)
+			pool->submit([this, s] { runTask(s); });
+	}
+	remaining--;
+}
+
+bool TaskGraph::run(JobPool *jobs) {
+	if (tasks.empty()) return true;
+	if (order.empty() && !sort()) return false;
+
+	if (jobs == NULL || jobs->getNumThreads() == 0) {
+		for (int t : order)
+			tasks[t].fn();
+		return true;
+	}
+
+	pool = jobs;
+	remaining = (int)tasks.size();
+	for (int i = 0; i < tasks.size(); i++)
+		waiting[i] = tasks[i].numDeps;
+	for (int i = 0; i < tasks.size(); i++) {
+		if (tasks[i].numDeps == 0)
+			jobs->submit([this, i] { runTask(i); });
+	}
+
+	// help out until everything is done
+	//
+	while (remaining > 0) {
+		if (!jobs->runOne()) std::this_thread::yield();
+	}
+	return true;
+}
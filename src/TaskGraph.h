@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "JobPool.h"
+
+//  Tasks with dependencies, run on a JobPool.
+//
+//  Build the graph once with add() and depend(), then run() it as often as
+//  needed (every simulation step).  A task is submitted to the pool as soon
+//  as the tasks it depends on are done, so independent tasks run at the
+//  same time.  The thread calling run() works on the tasks too and returns
+//  when all of them are done.
+//
+//  Tasks can use the same pool for their own parallel work (parallelFor);
+//  waiting there runs other jobs, so nothing deadlocks on a full pool.
+//
+class TaskGraph {
+public:
+	typedef std::function<void()> Task;
+
+	// returns the id of the new task.  name is not copied, it must outlive
+	// the graph.
+	//
+	int add(const char *name, Task fn);
+
+	// task won't start before "on" is done
+	//
+	void depend(int task, int on);
+	void clear();
+
+	int size() const { return (int)tasks.size(); }
+	const char * getName(int task) const { return tasks[task].name; }
+
+	// run every task once.  jobs == NULL runs them one after the other on
+	// the calling thread, in an order that respects the dependencies.
+	// Returns false (and runs nothing) if the dependencies have a cycle.
+	//
+	bool run(JobPool *jobs);
+
+private:
+	struct Node {
+		const char *name;
+		Task fn;
+		std::vector<int> successors;
+		int numDeps = 0;
+	};
+
+	bool sort();
+	void runTask(int task);
+
+	std::vector<Node> tasks;
+	std::vector<int> order;          // topological order, empty when out of date
+	std::unique_ptr<std::atomic<int>[]> waiting;    // per task, dependencies not yet done
+	std::atomic<int> remaining{ 0 };
+	JobPool *pool = NULL;            // of the current run
+};
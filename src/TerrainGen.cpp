@@ -0,0 +1,77 @@
+
+#include "TerrainGen.h"
+#include "Random.h"
+#include "Util.h"
+
+// value noise: random heights on an integer lattice, smoothly interpolated
+//
+static float latticeValue(const CounterRNG &rng, int x, int z) {
+	return rng.uniform((uint32_t)x, (uint32_t)z, 0, 1);
+}
+
+static float valueNoise(const CounterRNG &rng, float x, float z) {
+	int ix = (int)floor(x);
+	int iz = (int)floor(z);
+	float fx = x - ix;
+	float fz = z - iz;
+	fx = fx * fx * (3 - 2 * fx);
+	fz = fz * fz * (3 - 2 * fz);
+	float a = latticeValue(rng, ix, iz);
+	float b = latticeValue(rng, ix + 1, iz);
+	float c = latticeValue(rng, ix, iz + 1);
+	float d = latticeValue(rng, ix + 1, iz + 1);
+	return ofLerp(ofLerp(a, b, fx), ofLerp(c, d, fx), fz);
+}
+
+ofMesh makeTerrain(int resolution, float size, float amplitude, uint32_t seed) {
+	CounterRNG rng(seed, 0);
+	ofMesh mesh;
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+
+	int n = resolution + 1;
+	float half = size / 2;
+	for (int j = 0; j < n; j++) {
+		for (int i = 0; i < n; i++) {
+			float x = -half + size * i / resolution;
+			float z = -half + size * j / resolution;
+
+			// hills plus three octaves of noise, scaled to [0, 1]
+			//
+			float h = 0.5 + 0.25 * sin(x * 4 / size) * cos(z * 3 / size);
+			float scale = 8.0 / size;
+			float weight = 0.25;
+			for (int octave = 0; octave < 3; octave++) {
+				h += weight * (valueNoise(rng, x * scale, z * scale) - 0.5);
+				scale *= 2;
+				weight /= 2;
+			}
+			mesh.addVertex(ofVec3f(x, ofClamp(h, 0, 1) * amplitude, z));
+		}
+	}
+
+	for (int j = 0; j < resolution; j++) {
+		for (int i = 0; i < resolution; i++) {
+			int a = j * n + i;
+			mesh.addIndex(a);
+			mesh.addIndex(a + n);
+			mesh.addIndex(a + 1);
+			mesh.addIndex(a + 1);
+			mesh.addIndex(a + n);
+			mesh.addIndex(a + n + 1);
+		}
+	}
+	return mesh;
+}
+
+vector<ofVec3f> makeQueryPoints(const ofMesh &mesh, int n, uint32_t seed) {
+	CounterRNG rng(seed, 1);
+	ofVec3f min, max;
+	meshBounds(mesh, min, max);
+	vector<ofVec3f> points(n);
+	for (int i = 0; i < n; i++) {
+		float r[4];
+		rng.uniform4(i, 0, r);
+		points[i] = min + (max - min) * ofVec3f(r[0], r[1], r[2]);
+	}
+	return points;
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include "ofMain.h"
+
+//  Synthetic terrain, so benchmarks and headless runs don't need the game
+//  assets.
+//
+//  makeTerrain returns a triangulated (resolution + 1)^2 vertex height field
+//  of size x size centered on the origin in xz.  Heights are a few octaves of
+//  rolling hills plus seeded value noise, between 0 and amplitude.  The same
+//  arguments always give the same mesh.
+//
+ofMesh makeTerrain(int resolution, float size, float amplitude, uint32_t seed = 0);
+
+//  n points spread uniformly over the bounding box of mesh, for query
+//  benchmarks
+//
+vector<ofVec3f> makeQueryPoints(const ofMesh &mesh, int n, uint32_t seed = 0);
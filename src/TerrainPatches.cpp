@@ -0,0 +1,84 @@
+
+#include <cfloat>
+#include "TerrainPatches.h"
+#include "Profiler.h"
+#include "AllocTracker.h"
+
+bool TerrainPatches::create(const ofMesh &mesh, float patchSize) {
+	PROFILE_SCOPE("TerrainPatches::create");
+	ALLOC_TAG(ALLOC_PROPS);
+	patches.clear();
+	if (mesh.getNumVertices() == 0) return false;
+	bounds = Octree::meshBounds(mesh);
+	this->patchSize = patchSize;
+	while (!build(mesh)) {
+		this->patchSize /= 2;
+		cout << "TerrainPatches: too many vertices in a patch, trying " << this->patchSize << endl;
+	}
+	return true;
+}
+
+// false if a patch doesn't fit its 16-bit tree
+//
+bool TerrainPatches::build(const ofMesh &mesh) {
+	const Vector3 &min = bounds.parameters[0];
+	const Vector3 &max = bounds.parameters[1];
+	dims[0] = std::max(1, (int)ceil((max.x() - min.x()) / patchSize));
+	dims[1] = std::max(1, (int)ceil((max.z() - min.z()) / patchSize));
+
+	// wide enough that every patch's vertices reach past its edges, also
+	// on a coarse mesh
+	//
+	float spacing = sqrt((max.x() - min.x()) * (max.z() - min.z()) / mesh.getNumVertices());
+	float margin = std::max(patchSize / 8, 2 * spacing);
+
+	vector<ofMesh> meshes(dims[0] * dims[1]);
+	for (int i = 0; i < mesh.getNumVertices(); i++) {
+		glm::vec3 v = mesh.getVertex(i);
+		int x0 = ofClamp(floor((v.x - margin - min.x()) / patchSize), 0, dims[0] - 1);
+		int x1 = ofClamp(floor((v.x + margin - min.x()) / patchSize), 0, dims[0] - 1);
+		int z0 = ofClamp(floor((v.z - margin - min.z()) / patchSize), 0, dims[1] - 1);
+		int z1 = ofClamp(floor((v.z + margin - min.z()) / patchSize), 0, dims[1] - 1);
+		for (int k = z0; k <= z1; k++) {
+			for (int j = x0; j <= x1; j++) meshes[k * dims[0] + j].addVertex(v);
+		}
+	}
+
+	const size_t maxVertices = std::numeric_limits<uint16_t>::max();
+	for (int p = 0; p < meshes.size(); p++) {
+		if (meshes[p].getNumVertices() > maxVertices) return false;
+	}
+	patches = vector<PatchQuadtree>(meshes.size());
+	for (int p = 0; p < meshes.size(); p++) {
+		if (meshes[p].getNumVertices() > 0) patches[p].create(meshes[p]);
+	}
+	return true;
+}
+
+int TerrainPatches::patchIndex(float x, float z) const {
+	const Vector3 &min = bounds.parameters[0];
+	int i = ofClamp(floor((x - min.x()) / patchSize), 0, dims[0] - 1);
+	int k = ofClamp(floor((z - min.z()) / patchSize), 0, dims[1] - 1);
+	return k * dims[0] + i;
+}
+
+void TerrainPatches::columnHeights(const ofVec2f *xz, int n, float *heightRtn) const {
+	const Vector3 &min = bounds.parameters[0];
+	const Vector3 &max = bounds.parameters[1];
+	for (int i = 0; i < n; i++) {
+		const ofVec2f &p = xz[i];
+		if (patches.empty() || p.x < min.x() || p.x > max.x() || p.y < min.z() || p.y > max.z()) {
+			heightRtn[i] = -FLT_MAX;
+			continue;
+		}
+		patches[patchIndex(p.x, p.y)].columnHeights(&p, 1, &heightRtn[i]);
+	}
+}
+
+size_t TerrainPatches::getMemoryUsage() const {
+	size_t bytes = patches.size() * sizeof(PatchQuadtree);
+	for (int p = 0; p < patches.size(); p++) {
+		bytes += patches[p].getMemoryUsage() + patches[p].mesh.getNumVertices() * sizeof(glm::vec3);
+	}
+	return bytes;
+}
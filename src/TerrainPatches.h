@@ -0,0 +1,41 @@
+#pragma once
+#include "ofMain.h"
+#include "box.h"
+#include "OctreeT.h"
+
+//  The terrain cut into square patches in xz, each with its own small
+//  PatchQuadtree (16-bit indices, at most 6 levels), for the height queries
+//  of the prop scatter and the occlusion culler.  The simulation keeps its
+//  Octree.
+//
+//  A patch also holds the vertices within a margin around it, so a query
+//  near its edge still finds a close vertex.  columnHeights() answers like
+//  Octree::columnHeights() but only walks the one shallow tree of the
+//  patch under the query.
+//
+class TerrainPatches {
+public:
+	// patches that would hold more vertices than 16 bits can index are
+	// halved until they fit.  False for an empty mesh.
+	//
+	bool create(const ofMesh &mesh, float patchSize = 32);
+
+	// for each (x, z), see Octree::columnHeights().  -FLT_MAX outside the
+	// terrain.
+	//
+	void columnHeights(const ofVec2f *xz, int n, float *heightRtn) const;
+
+	const Box & getBounds() const { return bounds; }
+	float getPatchSize() const { return patchSize; }
+	int getNumPatches() const { return (int)patches.size(); }
+	size_t getMemoryUsage() const;
+
+private:
+	int patchIndex(float x, float z) const;
+	bool build(const ofMesh &mesh);
+
+	Box bounds;
+	float patchSize = 32;
+	int dims[2] = { 0, 0 };        // patches in x and z
+	vector<PatchQuadtree> patches;  // no nodes where the terrain has no vertices
+};
@@ -0,0 +1,283 @@
+#include <cfloat>
+#include "TerrainSDF.h"
+#include "Profiler.h"
+#include "AllocTracker.h"
+
+// vertices of triangle t of the mesh (indexed or plain triangle list)
+//
+static int numTriangles(const ofMesh & mesh) {
+   if (mesh.getNumIndices() > 0) return mesh.getNumIndices() / 3;
+   return mesh.getNumVertices() / 3;
+}
+
+static void getTriangle(const ofMesh & mesh, int t, ofVec3f & a, ofVec3f & b, ofVec3f & c) {
+   if (mesh.getNumIndices() > 0) {
+      a = mesh.getVertex(mesh.getIndex(t * 3));
+      b = mesh.getVertex(mesh.getIndex(t * 3 + 1));
+      c = mesh.getVertex(mesh.getIndex(t * 3 + 2));
+   }
+   else {
+      a = mesh.getVertex(t * 3);
+      b = mesh.getVertex(t * 3 + 1);
+      c = mesh.getVertex(t * 3 + 2);
+   }
+}
+
+// closest point on triangle abc to p  (Ericson, Real-Time Collision Detection 5.1.5)
+//
+static ofVec3f closestPtPointTriangle(const ofVec3f & p, const ofVec3f & a, const ofVec3f & b, const ofVec3f & c) {
+   ofVec3f ab = b - a;
+   ofVec3f ac = c - a;
+   ofVec3f ap = p - a;
+   float d1 = ab.dot(ap);
+   float d2 = ac.dot(ap);
+   if (d1 <= 0 && d2 <= 0) return a;
+
+   ofVec3f bp = p - b;
+   float d3 = ab.dot(bp);
+   float d4 = ac.dot(bp);
+   if (d3 >= 0 && d4 <= d3) return b;
+
+   float vc = d1 * d4 - d3 * d2;
+   if (vc <= 0 && d1 >= 0 && d3 <= 0) return a + ab * (d1 / (d1 - d3));
+
+   ofVec3f cp = p - c;
+   float d5 = ab.dot(cp);
+   float d6 = ac.dot(cp);
+   if (d6 >= 0 && d5 <= d6) return c;
+
+   float vb = d5 * d2 - d1 * d6;
+   if (vb <= 0 && d2 >= 0 && d6 <= 0) return a + ac * (d2 / (d2 - d6));
+
+   float va = d3 * d6 - d5 * d4;
+   if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+      return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+   float denom = 1 / (va + vb + vc);
+   return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+void TerrainSDF::create(const Octree & oct, float voxelSize, float band) {
+   PROFILE_SCOPE("TerrainSDF::create");
+   ALLOC_TAG(ALLOC_OCTREE);
+   this->voxelSize = voxelSize;
+   this->band = band;
+
+   // grid covers the octree root box, padded by the band on all sides
+   //
+   ofVec3f pad = ofVec3f(band, band, band);
+   origin = oct.root.box.min().as<ofVec3f>() - pad;
+   ofVec3f size = oct.root.box.max().as<ofVec3f>() + pad - origin;
+   float brickSize = voxelSize * BRICK;
+   for (int i = 0; i < 3; i++) {
+      dims[i] = (int)ceil(size[i] / brickSize);
+      if (dims[i] < 1) dims[i] = 1;
+   }
+   heightDims[0] = dims[0] * BRICK + 1;
+   heightDims[1] = dims[2] * BRICK + 1;
+
+   allocateBricks(oct);
+   buildHeights(oct.mesh);
+   scatterTriangles(oct.mesh);
+   applySign();
+
+   cout << "SDF bricks: " << numBricks << " of " << brickTable.size()
+      << " (" << getMemoryUsage() / 1024 << " KB)" << endl;
+}
+
+// allocate every brick that lies within the band of an octree leaf
+//
+void TerrainSDF::allocateBricks(const Octree & oct) {
+   brickTable.assign(dims[0] * dims[1] * dims[2], -1);
+   brickSign.assign(brickTable.size(), 1);
+   numBricks = 0;
+
+   vector<const TreeNode *> leaves;
+   oct.getLeafNodes(oct.root, leaves);
+
+   const int brickSamples = BRICK_SAMPLES * BRICK_SAMPLES * BRICK_SAMPLES;
+   float brickSize = voxelSize * BRICK;
+   for (int n = 0; n < leaves.size(); n++) {
+      const Vector3 &min = leaves[n]->box.parameters[0];
+      const Vector3 &max = leaves[n]->box.parameters[1];
+      int b0[3], b1[3];
+      for (int i = 0; i < 3; i++) {
+         b0[i] = ofClamp(floor((min[i] - band - origin[i]) / brickSize), 0, dims[i] - 1);
+         b1[i] = ofClamp(floor((max[i] + band - origin[i]) / brickSize), 0, dims[i] - 1);
+      }
+      for (int bz = b0[2]; bz <= b1[2]; bz++)
+         for (int by = b0[1]; by <= b1[1]; by++)
+            for (int bx = b0[0]; bx <= b1[0]; bx++) {
+               int &entry = brickTable[brickIndex(bx, by, bz)];
+               if (entry < 0) entry = brickSamples * numBricks++;
+            }
+   }
+   samples.assign(numBricks * brickSamples, band);
+}
+
+// rasterize the triangles into a height map (one height per sample column)
+// in the xz plane, keeping the highest surface.  Used for the sign.
+//
+void TerrainSDF::buildHeights(const ofMesh & mesh) {
+   heights.assign(heightDims[0] * heightDims[1], -FLT_MAX);
+
+   const float eps = 1e-6;
+   int n = numTriangles(mesh);
+   for (int t = 0; t < n; t++) {
+      ofVec3f a, b, c;
+      getTriangle(mesh, t, a, b, c);
+
+      float area = (b.x - a.x) * (c.z - a.z) - (c.x - a.x) * (b.z - a.z);
+      if (fabs(area) < eps) continue;   // vertical or degenerate
+
+      int i0 = ofClamp(ceil((std::min({ a.x, b.x, c.x }) - origin.x) / voxelSize), 0, heightDims[0] - 1);
+      int i1 = ofClamp(floor((std::max({ a.x, b.x, c.x }) - origin.x) / voxelSize), 0, heightDims[0] - 1);
+      int k0 = ofClamp(ceil((std::min({ a.z, b.z, c.z }) - origin.z) / voxelSize), 0, heightDims[1] - 1);
+      int k1 = ofClamp(floor((std::max({ a.z, b.z, c.z }) - origin.z) / voxelSize), 0, heightDims[1] - 1);
+      for (int k = k0; k <= k1; k++) {
+         float z = origin.z + k * voxelSize;
+         for (int i = i0; i <= i1; i++) {
+            float x = origin.x + i * voxelSize;
+            float w0 = ((b.x - x) * (c.z - z) - (c.x - x) * (b.z - z)) / area;
+            float w1 = ((c.x - x) * (a.z - z) - (a.x - x) * (c.z - z)) / area;
+            float w2 = 1 - w0 - w1;
+            if (w0 < -eps || w1 < -eps || w2 < -eps) continue;
+            float y = w0 * a.y + w1 * b.y + w2 * c.y;
+            float &h = heights[k * heightDims[0] + i];
+            if (y > h) h = y;
+         }
+      }
+   }
+}
+
+// write the unsigned distance to each triangle into all samples within
+// the band of it.  Samples on a brick border are stored in every brick
+// that shares them.
+//
+void TerrainSDF::scatterTriangles(const ofMesh & mesh) {
+   int maxSample[3] = { dims[0] * BRICK, dims[1] * BRICK, dims[2] * BRICK };
+   int n = numTriangles(mesh);
+   for (int t = 0; t < n; t++) {
+      ofVec3f a, b, c;
+      getTriangle(mesh, t, a, b, c);
+
+      int s0[3], s1[3];
+      for (int i = 0; i < 3; i++) {
+         float lo = std::min({ a[i], b[i], c[i] }) - band;
+         float hi = std::max({ a[i], b[i], c[i] }) + band;
+         s0[i] = ofClamp(ceil((lo - origin[i]) / voxelSize), 0, maxSample[i]);
+         s1[i] = ofClamp(floor((hi - origin[i]) / voxelSize), 0, maxSample[i]);
+      }
+
+      for (int sk = s0[2]; sk <= s1[2]; sk++)
+         for (int sj = s0[1]; sj <= s1[1]; sj++)
+            for (int si = s0[0]; si <= s1[0]; si++) {
+               ofVec3f p = origin + ofVec3f(si, sj, sk) * voxelSize;
+               float d = (p - closestPtPointTriangle(p, a, b, c)).length();
+               if (d >= band) continue;
+
+               // bricks (and local index) holding this sample along each axis
+               //
+               int s[3] = { si, sj, sk };
+               int brick[3][2], local[3][2], count[3];
+               for (int i = 0; i < 3; i++) {
+                  count[i] = 0;
+                  int bi = s[i] / BRICK;
+                  int li = s[i] % BRICK;
+                  if (bi < dims[i]) {
+                     brick[i][count[i]] = bi;
+                     local[i][count[i]++] = li;
+                  }
+                  if (li == 0 && bi > 0) {
+                     brick[i][count[i]] = bi - 1;
+                     local[i][count[i]++] = BRICK;
+                  }
+               }
+               for (int z = 0; z < count[2]; z++)
+                  for (int y = 0; y < count[1]; y++)
+                     for (int x = 0; x < count[0]; x++) {
+                        int base = brickTable[brickIndex(brick[0][x], brick[1][y], brick[2][z])];
+                        if (base < 0) continue;
+                        float &v = samples[base + sampleOffset(local[0][x], local[1][y], local[2][z])];
+                        if (d < v) v = d;
+                     }
+            }
+   }
+}
+
+// samples below the height field are inside the terrain
+//
+void TerrainSDF::applySign() {
+   for (int bz = 0; bz < dims[2]; bz++)
+      for (int by = 0; by < dims[1]; by++)
+         for (int bx = 0; bx < dims[0]; bx++) {
+            int index = brickIndex(bx, by, bz);
+            int base = brickTable[index];
+            if (base < 0) {
+               float y = origin.y + (by * BRICK + BRICK / 2) * voxelSize;
+               brickSign[index] = (y < heightAt(bx * BRICK + BRICK / 2, bz * BRICK + BRICK / 2)) ? -1 : 1;
+               continue;
+            }
+            for (int k = 0; k < BRICK_SAMPLES; k++)
+               for (int j = 0; j < BRICK_SAMPLES; j++) {
+                  float y = origin.y + (by * BRICK + j) * voxelSize;
+                  for (int i = 0; i < BRICK_SAMPLES; i++) {
+                     if (y < heightAt(bx * BRICK + i, bz * BRICK + k)) {
+                        float &v = samples[base + sampleOffset(i, j, k)];
+                        v = -v;
+                     }
+                  }
+               }
+         }
+}
+
+float TerrainSDF::distance(const ofVec3f & p) const {
+   ofVec3f gradient;
+   return sample(p, gradient);
+}
+
+float TerrainSDF::sample(const ofVec3f & p, ofVec3f & gradient) const {
+   gradient = ofVec3f(0, 1, 0);
+   if (!isCreated()) return band;
+
+   float gx = (p.x - origin.x) / voxelSize;
+   float gy = (p.y - origin.y) / voxelSize;
+   float gz = (p.z - origin.z) / voxelSize;
+   if (gx < 0 || gz < 0 || gx >= dims[0] * BRICK || gz >= dims[2] * BRICK || gy >= dims[1] * BRICK)
+      return band;
+   if (gy < 0) return -band;    // under the whole terrain
+
+   int ix = (int)gx, iy = (int)gy, iz = (int)gz;
+   int bx = ix / BRICK, by = iy / BRICK, bz = iz / BRICK;
+   int index = brickIndex(bx, by, bz);
+   int base = brickTable[index];
+   if (base < 0) return brickSign[index] * band;
+
+   // trilinear interpolation of the 8 samples around p
+   //
+   const int dy = BRICK_SAMPLES;
+   const int dz = BRICK_SAMPLES * BRICK_SAMPLES;
+   const float *s = &samples[base + sampleOffset(ix - bx * BRICK, iy - by * BRICK, iz - bz * BRICK)];
+   float fx = gx - ix, fy = gy - iy, fz = gz - iz;
+
+   float c00 = s[0] + (s[1] - s[0]) * fx;
+   float c10 = s[dy] + (s[dy + 1] - s[dy]) * fx;
+   float c01 = s[dz] + (s[dz + 1] - s[dz]) * fx;
+   float c11 = s[dz + dy] + (s[dz + dy + 1] - s[dz + dy]) * fx;
+   float c0 = c00 + (c10 - c00) * fy;
+   float c1 = c01 + (c11 - c01) * fy;
+
+   // analytic gradient of the interpolant
+   //
+   float x0 = (s[1] - s[0]) + ((s[dy + 1] - s[dy]) - (s[1] - s[0])) * fy;
+   float x1 = (s[dz + 1] - s[dz]) + ((s[dz + dy + 1] - s[dz + dy]) - (s[dz + 1] - s[dz])) * fy;
+   ofVec3f g = ofVec3f(x0 + (x1 - x0) * fz, (c10 - c00) + ((c11 - c01) - (c10 - c00)) * fz, c1 - c0);
+   if (g.length() > 1e-6) gradient = g.getNormalized();
+
+   return c0 + (c1 - c0) * fz;
+}
+
+size_t TerrainSDF::getMemoryUsage() const {
+   return brickTable.size() * sizeof(int) + brickSign.size() +
+      samples.size() * sizeof(float) + heights.size() * sizeof(float);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include "ofMain.h"
+#include "Octree.h"
+
+//  Sparse signed distance field of the terrain, used for collision response.
+//
+//  The field is sampled on a regular voxel grid that is split into bricks of
+//  BRICK x BRICK x BRICK voxels.  Only bricks within "band" of the surface
+//  (found from the Octree leaf boxes) are allocated; each allocated brick keeps
+//  its own (BRICK + 1)^3 samples so a trilinear lookup never crosses a brick.
+//  Unallocated bricks just report +/- band.
+//
+//  The terrain is treated as a height field: distance is negative below
+//  the surface and positive above it.
+//
+class TerrainSDF {
+public:
+   static const int BRICK = 8;
+   static const int BRICK_SAMPLES = BRICK + 1;
+
+   void create(const Octree & oct, float voxelSize, float band);
+
+   // signed distance at p, trilinear interpolated
+   //
+   float distance(const ofVec3f & p) const;
+
+   // signed distance at p, also returns the (normalized) gradient of the
+   // field, which is the surface normal near the terrain.
+   //
+   float sample(const ofVec3f & p, ofVec3f & gradient) const;
+
+   bool isCreated() const { return !brickTable.empty(); }
+   int getNumBricks() const { return numBricks; }
+   size_t getMemoryUsage() const;
+
+   float voxelSize = 1;
+   float band = 4;
+   ofVec3f origin;     // min corner of the grid
+   int dims[3];        // grid size in bricks
+
+private:
+   int brickIndex(int bx, int by, int bz) const {
+      return (bz * dims[1] + by) * dims[0] + bx;
+   }
+   int sampleOffset(int i, int j, int k) const {
+      return (k * BRICK_SAMPLES + j) * BRICK_SAMPLES + i;
+   }
+   void allocateBricks(const Octree & oct);
+   void buildHeights(const ofMesh & mesh);
+   void scatterTriangles(const ofMesh & mesh);
+   void applySign();
+   float heightAt(int si, int sk) const { return heights[sk * heightDims[0] + si]; }
+
+   int numBricks = 0;
+   int heightDims[2];
+   vector<int> brickTable;          // brick grid -> first sample of the brick, -1 if empty
+   vector<signed char> brickSign;   // sign reported by empty bricks
+   vector<float> samples;           // BRICK_SAMPLES^3 distances per allocated brick
+   vector<float> heights;           // terrain height at each sample column
+};
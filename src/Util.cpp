@@ -1,6 +1,8 @@
 
 // Kevin M.Smith - CS 134 SJSU
 
+#include <fstream>
+#include <sstream>
 #include "Util.h"
 
 
@@ -35,4 +37,62 @@ bool rayIntersectPlane(const ofVec3f &rayPoint, const ofVec3f &raydir, const ofV
 //
 ofVec3f reflectVector(const ofVec3f &v, const ofVec3f &n) {
 	return (v - 2 * v.dot(n) * n);
-}
\ No newline at end of file
+}
+
+//---------------------------------------------------------------
+// Minimal Wavefront OBJ reader for running without a window (ofxAssimp
+// needs a GL context).  Only "v" and "f" lines are used; faces are
+// triangulated as fans and texture/normal indices are ignored.
+// path is relative to the data folder.
+//
+bool loadObjMesh(const string &path, ofMesh &mesh) {
+	std::ifstream in(ofToDataPath(path).c_str());
+	if (!in) return false;
+
+	mesh.clear();
+	mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+	string line;
+	vector<int> face;
+	while (std::getline(in, line)) {
+		std::istringstream ss(line);
+		string type;
+		ss >> type;
+		if (type == "v") {
+			float x, y, z;
+			ss >> x >> y >> z;
+			mesh.addVertex(ofVec3f(x, y, z));
+		}
+		else if (type == "f") {
+			// each corner is "v", "v/vt", "v//vn" or "v/vt/vn", negative
+			// indices count back from the last vertex
+			//
+			face.clear();
+			string corner;
+			while (ss >> corner) {
+				int v = atoi(corner.c_str());
+				face.push_back(v < 0 ? (int)mesh.getNumVertices() + v : v - 1);
+			}
+			for (int i = 2; i < face.size(); i++) {
+				mesh.addIndex(face[0]);
+				mesh.addIndex(face[i - 1]);
+				mesh.addIndex(face[i]);
+			}
+		}
+	}
+	return mesh.getNumVertices() > 0;
+}
+
+void meshBounds(const ofMesh &mesh, ofVec3f &min, ofVec3f &max) {
+	min = max = ofVec3f(0, 0, 0);
+	if (mesh.getNumVertices() == 0) return;
+	min = max = mesh.getVertex(0);
+	for (int i = 1; i < mesh.getNumVertices(); i++) {
+		ofVec3f v = mesh.getVertex(i);
+		min.x = std::min(min.x, v.x);
+		min.y = std::min(min.y, v.y);
+		min.z = std::min(min.z, v.z);
+		max.x = std::max(max.x, v.x);
+		max.y = std::max(max.y, v.y);
+		max.z = std::max(max.z, v.z);
+	}
+}
@@ -8,5 +8,13 @@ bool rayIntersectPlane(const ofVec3f &rayPoint, const ofVec3f &raydir, ofVec3f c
 
 ofVec3f reflectVector(const ofVec3f &v, const ofVec3f &normal);
 
+// load the vertices and faces of a Wavefront OBJ file without a GL context
+//
+bool loadObjMesh(const string &path, ofMesh &mesh);
+
+// bounding box of the vertices of mesh
+//
+void meshBounds(const ofMesh &mesh, ofVec3f &min, ofVec3f &max);
+
 
 
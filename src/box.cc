@@ -12,6 +12,45 @@
  *
  */
 
+#ifdef VECTOR3_SSE
+
+/*
+ * Same slab test with all three axes at once.  The sign mask picks the near
+ * and far corner per lane, then the entry and exit distances are reduced
+ * over x, y and z.
+ *
+ * A lane is NaN when an axis-parallel ray starts exactly on a slab plane.
+ * The reduction keeps the scalar test's answer for those: it starts from x
+ * and folds in y and z with max_ss/min_ss, which return their second
+ * operand (the running value) for a NaN.  So a NaN in y or z leaves the
+ * interval alone, and a NaN in x carries through and misses, as in the
+ * scalar comparisons.
+ */
+
+bool Box::intersect(const Ray &r, float t0, float t1) const {
+  __m128 lo = parameters[0].simd();
+  __m128 hi = parameters[1].simd();
+  __m128 inv = r.inv_direction.simd();
+  __m128 neg = _mm_cmplt_ps(inv, _mm_setzero_ps());
+  __m128 nearCorner = _mm_or_ps(_mm_and_ps(neg, hi), _mm_andnot_ps(neg, lo));
+  __m128 farCorner = _mm_or_ps(_mm_and_ps(neg, lo), _mm_andnot_ps(neg, hi));
+  __m128 tnear = _mm_mul_ps(_mm_sub_ps(nearCorner, r.origin.simd()), inv);
+  __m128 tfar = _mm_mul_ps(_mm_sub_ps(farCorner, r.origin.simd()), inv);
+
+  __m128 tmin = tnear;
+  tmin = _mm_max_ss(_mm_shuffle_ps(tnear, tnear, _MM_SHUFFLE(1, 1, 1, 1)), tmin);
+  tmin = _mm_max_ss(_mm_shuffle_ps(tnear, tnear, _MM_SHUFFLE(2, 2, 2, 2)), tmin);
+  __m128 tmax = tfar;
+  tmax = _mm_min_ss(_mm_shuffle_ps(tfar, tfar, _MM_SHUFFLE(1, 1, 1, 1)), tmax);
+  tmax = _mm_min_ss(_mm_shuffle_ps(tfar, tfar, _MM_SHUFFLE(2, 2, 2, 2)), tmax);
+
+  float tminf = _mm_cvtss_f32(tmin);
+  float tmaxf = _mm_cvtss_f32(tmax);
+  return ( (tminf <= tmaxf) && (tminf < t1) && (tmaxf > t0) );
+}
+
+#else
+
 bool Box::intersect(const Ray &r, float t0, float t1) const {
   float tmin, tmax, tymin, tymax, tzmin, tzmax;
 
@@ -35,3 +74,5 @@ bool Box::intersect(const Ray &r, float t0, float t1) const {
     tmax = tzmax;
   return ( (tmin < t1) && (tmax > t0) );
 }
+
+#endif
@@ -28,12 +28,18 @@ public:
 
    // corners
    Vector3 parameters[2];
-   Vector3 min() { return parameters[0]; }
-   Vector3 max() { return parameters[1]; }
+   Vector3 min() const { return parameters[0]; }
+   Vector3 max() const { return parameters[1]; }
    const bool inside(const Vector3 &p) const {
+#ifdef VECTOR3_SSE
+      __m128 in = _mm_and_ps(_mm_cmpge_ps(p.simd(), parameters[0].simd()),
+         _mm_cmple_ps(p.simd(), parameters[1].simd()));
+      return (_mm_movemask_ps(in) & 7) == 7;
+#else
       return ((p.x() >= parameters[0].x() && p.x() <= parameters[1].x()) &&
          (p.y() >= parameters[0].y() && p.y() <= parameters[1].y()) &&
          (p.z() >= parameters[0].z() && p.z() <= parameters[1].z()));
+#endif
    }
    const bool inside(Vector3 *points, int size) {
       bool allInside = true;
@@ -43,7 +49,7 @@ public:
       }
       return allInside;
    }
-   Vector3 center() {
+   Vector3 center() const {
       return ((max() - min()) / 2 + min());
    }
 };
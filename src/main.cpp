@@ -1,13 +1,38 @@
 #include "ofMain.h"
 #include "ofApp.h"
+#include "Headless.h"
+#include "Benchmark.h"
 
 //========================================================================
-int main( ){
+int main(int argc, char *argv[]){
+
+	// --headless runs the simulation without a window, see Headless.h
+	// --bench runs the microbenchmarks, see Benchmark.h
+	//
+	HeadlessOptions opts;
+	BenchOptions benchOpts;
+	bool ok;
+	if (parseHeadlessOptions(argc, argv, opts, ok)) {
+		return ok ? runHeadless(opts) : 1;
+	}
+	if (parseBenchOptions(argc, argv, benchOpts, ok)) {
+		return ok ? runBenchmarks(benchOpts) : 1;
+	}
+
+	// --record file saves the pilot's controls on exit, --replay file flies
+	// a saved recording (see InputRecorder.h)
+	//
+	ofApp *app = new ofApp();
+	for (int i = 1; i + 1 < argc; i++) {
+		if (string(argv[i]) == "--record") app->recordPath = argv[++i];
+		else if (string(argv[i]) == "--replay") app->replayPath = argv[++i];
+	}
+
 	ofSetupOpenGL(1600,900,OF_WINDOW);			// <-------- setup the GL context
 
 	// this kicks off the running of my app
 	// can be OF_WINDOW or OF_FULLSCREEN
 	// pass in width and height too:
-	ofRunApp(new ofApp());
+	ofRunApp(app);
 
 }
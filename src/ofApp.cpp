@@ -5,71 +5,23 @@
 void ofApp::setup() {
    ofSetBackgroundColor(ofColor::black);
 
-   // Particles & Physics Setup
-   sys = new ParticleSystem();
-   grav = new GravityForce();
-   moveForce = new MovementForce();
-   turb = new TurbulenceForce(ofVec3f(-1, 0, -1), ofVec3f(1, 0, 1));
-
-   currentPos = glm::vec3(0, 30, 0);
-
-   ship.position = currentPos;
-   ship.velocity = ofVec3f(0, 0);
-   ship.radius = 1;
-   ship.damping = 0.9995;
-
-   sys->add(ship);
-   sys->setLifespan(10000000);
-   sys->addForce(grav);
-   sys->addForce(moveForce);
-   sys->addForce(turb);
-
-   // Thruster Setup
-   radialForce = new ImpulseRadialForce(1000);
-   radialForce->setHeight(0.2);
-   cyclicForce = new CyclicForce(500);
-
-   thrusterEmitter.sys->addForce(radialForce);
-   thrusterEmitter.sys->addForce(cyclicForce);
-   thrusterEmitter.setVelocity(ofVec3f(0, -100, 0));
-   thrusterEmitter.setEmitterType(DirectionalEmitter);
-   thrusterEmitter.setGroupSize(200);
-   thrusterEmitter.setRandomLife(true);
-   thrusterEmitter.setLifespanRange(ofVec2f(0.05, 0.1));
-   thrusterEmitter.setRate(20);
-
-   radialCorn = new ImpulseRadialForce(1000);
-   radialCorn->setHeight(0.2);
-   cyclicCorn = new CyclicForce(5);
-
-   cornEmitter.sys->addForce(radialCorn);
-   cornEmitter.sys->addForce(cyclicCorn);
-   cornEmitter.setVelocity(ofVec3f(0, 0, 0));
-   cornEmitter.setEmitterType(RadialEmitter);
-   cornEmitter.setGroupSize(200);
-   cornEmitter.setRandomLife(true);
-   cornEmitter.setLifespanRange(ofVec2f(0.1, 0.3));
-   cornEmitter.setRate(20);
+   renderPos = glm::vec3(0, 30, 0);
 
    // texture loading
    //
    ofDisableArbTex();     // disable rectangular textures
 
-   // load textures
+   // load the particle texture and shader.  Particles shrink to half
+   // size and fade out over the second half of their life.
    //
-   string imagePath = "images/dot.png";
-   if (!ofLoadImage(particleTex, imagePath)) {
-      cout << "Particle Texture File: " << imagePath << " not found." << endl;
+   if (!particleRenderer.setup("images/dot.png")) {
       ofExit();
+      return;
    }
-
-   // load the shader
-   //
-#ifdef TARGET_OPENGLES
-   shader.load("shaders_gles/shader");
-#else
-   shader.load("shaders/shader");
-#endif
+   particleRenderer.setSizeOverLife(1.0, 0.5);
+   particleRenderer.setFadeStart(0.5);
+   thrustLayer = particleRenderer.add(ofColor::lightGoldenRodYellow, 5);
+   cornLayer = particleRenderer.add(ofColor::yellow, 5);
 
    // Models
    string modelPath = "Tractor/Tractor.obj";
@@ -79,6 +31,7 @@ void ofApp::setup() {
    else {
       ofLogFatalError("Can't load model: " + modelPath);
       ofExit();
+      return;
    }
 
    //modelPath = "cornMoon/cornMoon.obj";
@@ -90,6 +43,7 @@ void ofApp::setup() {
    else {
       ofLogFatalError("Can't load model: " + modelPath);
       ofExit();
+      return;
    }
 
    modelPath = "cornStalk/cornStalk.obj";
@@ -100,44 +54,51 @@ void ofApp::setup() {
    else {
       ofLogFatalError("Can't load model: " + modelPath);
       ofExit();
+      return;
+   }
+   if (!cornStalks.setup(corn)) {
+      ofExit();
+      return;
    }
 
    bWireframe = false;
    bBoundingBox = false;
 
-   // Landing Fields
-   Box l1 = Box(Vector3(-172, 16, 134), Vector3(-146, 18, 144));
-   Box l2 = Box(Vector3(110, 19, 91), Vector3(155, 21, 113));
-   Box l3 = Box(Vector3(170, 19, -165), Vector3(180, 21, -145));
-   landings.push_back(l1);
-   landings.push_back(l2);
-   landings.push_back(l3);
-
-   for (int i = 0; i < landings.size(); i++) {
-      Vector3 min = landings[i].parameters[0];
-      Vector3 max = landings[i].parameters[1];
-      corn.setPosition(min.x(), min.y(), min.z());
-      corns.push_back(corn);
-      corn.setPosition(max.x(), min.y(), max.z());
-      corns.push_back(corn);
-      corn.setPosition(min.x(), min.y(), max.z());
-      corns.push_back(corn);
-      corn.setPosition(max.x(), min.y(), min.z());
-      corns.push_back(corn);
+   // Octree, SDF and ship setup
+   sim.setup(cornField.getMesh(0), tractor.getSceneMin(), tractor.getSceneMax());
+
+   // Corn field on the terrain patches, clear of the landing fields.  The
+   // chunks around the ship are made now, the rest stream in as it moves.
+   ScatterRule cornRule;
+   scatterRadius = 150;
+   cornRule.propSize = corn.getSceneMax().y - corn.getSceneMin().y;
+   terrainPatches.create(sim.oct.mesh, 32);
+   cornScatter.setup(terrainPatches, cornRule, 32, &loaderJobs);
+   culler.setup();
+   culler.setOccluders(terrainPatches);
+   bCulling = true;
+   for (int i = 0; i < sim.landings.size(); i++) {
+      cornScatter.addKeepOut(sim.landings[i]);
+   }
+   cornScatter.load(sim.currentPos, scatterRadius);
+   cornScatter.getInstances(cornInstances);
+   cornStalks.setInstances(cornInstances.data(), (int)cornInstances.size());
+
+   // Input recording and replay, see main.cpp
+   float step = 1.0 / 120;
+   bRecording = !recordPath.empty();
+   if (bRecording) {
+      input.dt = step;
+      simThread.recorder = &input;
+   }
+   else if (!replayPath.empty()) {
+      if (!input.load(replayPath)) {
+         ofExit();
+         return;
+      }
+      step = input.dt;
+      simThread.replay = &input;
    }
-
-   // Octree
-   numLevels = 9;
-   cout << "Generating Octree with " << numLevels << " levels." << endl;
-   float startTime = ofGetElapsedTimeMillis();
-
-   oct.create(cornField.getMesh(0), numLevels);
-
-   float endTime = ofGetElapsedTimeMillis();
-   float createTime = (endTime - startTime);
-   cout << "Octree Creation Time: " << createTime << " ms" << endl;
-
-   selectedPoint = ofVec3f(0, 0, 0);
 
    bShowOct = false;
 
@@ -164,11 +125,11 @@ void ofApp::setup() {
    trackingCam.setGlobalPosition(glm::vec3(0, 200, 125));
    trackingCam.lookAt(glm::vec3(0, 0, 0));
 
-   landingCam.setGlobalPosition(currentPos);
+   landingCam.setGlobalPosition(renderPos);
    landingCam.lookAt(glm::vec3(0, 0, 0));
 
-   fixedCam.setGlobalPosition(glm::vec3(currentPos.x, currentPos.y + 25, currentPos.z + 25));
-   fixedCam.lookAt(currentPos);
+   fixedCam.setGlobalPosition(glm::vec3(renderPos.x, renderPos.y + 25, renderPos.z + 25));
+   fixedCam.lookAt(renderPos);
 
    bShowCams = false;
 
@@ -184,17 +145,18 @@ void ofApp::setup() {
    else {
       ofLogFatalError("Can't load sound: " + soundPath);
       ofExit();
+      return;
    }
 
    soundPath = "sounds/sfx_vehicle_engineloop.wav";
    if (thrusters.load(soundPath)) {
       thrusters.setMultiPlay(false);
       thrusters.setVolume(0.2f);
-      bThrust = false;
    }
    else {
       ofLogFatalError("Can't load sound: " + soundPath);
       ofExit();
+      return;
    }
 
    // Lighting
@@ -220,80 +182,88 @@ void ofApp::setup() {
    gui.add(gravity.setup("Gravity", 1, -10, 10));
    gui.add(radius.setup("Particle Radius", 5, 1, 10));
    bHide = true;
+   bShowProfiler = false;
    bShowPoint = false;
    bPaused = false;
+   gravityControl = gravity;
+   bShowAllocs = false;
+
+   // Physics runs on its own thread from here on, see SimThread.h
+   simThread.start(step, 8);
+   snap = &simThread.acquire();
 }
 
 //--------------------------------------------------------------
 void ofApp::update() {
+   PROFILE_FRAME();
+   PROFILE_SCOPE("ofApp::update");
+   AllocTracker::beginFrame();
+
+   // Latest state from the simulation thread, used for the whole frame
+   snap = &simThread.acquire();
+   simThread.setPaused(bPaused);
+
    if (!bPaused) {
-      grav->set(ofVec3f(0, -gravity, 0));
+      if (gravity != gravityControl) {
+         gravityControl = gravity;
+         control(CONTROL_GRAVITY, gravity);
+      }
 
       // Play Thrusters
-      if (bThrust && !thrusters.isPlaying()) {
+      if (snap->bThrust && !thrusters.isPlaying()) {
          thrusters.play();
       }
-
-      // Update Particles
-      sys->update();
-      thrusterEmitter.update();
-      cornEmitter.update();
-
-      if (bLanded && !cornEmitter.started) {
-         cornEmitter.start();
+      else if (!snap->bThrust && thrusters.isPlaying()) {
+         thrusters.stop();
       }
 
-      currentPos = sys->particles[0].position;
-
-      // Create Ship Bounding Box
-      ofVec3f min = tractor.getSceneMin() + tractor.getPosition();
-      ofVec3f max = tractor.getSceneMax() + tractor.getPosition();
-      shipBox = Box(Vector3(min.x, min.y, min.z), Vector3(max.x, max.y, max.z));
+      // Draw the ship between the last two steps
+      renderPos = snap->previousPos.getInterpolated(snap->currentPos, simThread.getAlpha(*snap));
 
       // Set tractor's position to the particles position
-      tractor.setPosition(currentPos.x, currentPos.y, currentPos.z);
-      thrusterEmitter.setPosition(currentPos);
-      cornEmitter.setPosition(currentPos);
+      tractor.setPosition(renderPos.x, renderPos.y, renderPos.z);
 
       // Set fixedCam as a trailing cam
-      fixedCam.setGlobalPosition(glm::vec3(currentPos.x, currentPos.y + 25, currentPos.z + 25));
-      fixedCam.lookAt(currentPos);
+      fixedCam.setGlobalPosition(glm::vec3(renderPos.x, renderPos.y + 25, renderPos.z + 25));
+      fixedCam.lookAt(renderPos);
 
       // Set trackingCam to follow the tractor from a fixed position
-      trackingCam.lookAt(currentPos);
+      trackingCam.lookAt(renderPos);
 
       // Set landingCam to tractor's position looking down
-      landingCam.setGlobalPosition(glm::vec3(currentPos.x, currentPos.y + 30, currentPos.z));
-      landingCam.lookAt(glm::vec3(currentPos.x, currentPos.y - 50, currentPos.z));
+      landingCam.setGlobalPosition(glm::vec3(renderPos.x, renderPos.y + 30, renderPos.z));
+      landingCam.lookAt(glm::vec3(renderPos.x, renderPos.y - 50, renderPos.z));
+   }
 
-      checkCollision();
-      checkAltitude();
+   // Stream the corn field around the ship and hide the chunks the
+   // camera can't see past the hills
+   bool bCornChanged = cornScatter.update(renderPos, scatterRadius);
+   if (bCulling) culler.begin(theCam->getModelViewProjectionMatrix());
+   bCornChanged |= cornScatter.cull(bCulling ? &culler : NULL);
+   if (bCornChanged) {
+      cornScatter.getInstances(cornInstances);
+      cornStalks.setInstances(cornInstances.data(), (int)cornInstances.size());
    }
 }
 
 //--------------------------------------------------------------
 void ofApp::draw() {
+   PROFILE_SCOPE("ofApp::draw");
    ofBackground(ofColor::lightGrey);
    
-   loadVboThrust();
-   loadVboCorn();
+   particleRenderer.setSize(thrustLayer, radius);
+   particleRenderer.setSize(cornLayer, radius);
+   particleRenderer.setParticles(thrustLayer, &snap->thrust);
+   particleRenderer.setParticles(cornLayer, &snap->corn);
+   particleRenderer.update();
+   cornStalks.update();
 
    ofEnableDepthTest();
-   shader.begin();
    theCam->begin();
 
    // Draw Particles
    //sys->draw(); // Ship particle
-   ofSetColor(ofColor::lightGoldenRodYellow);
-   ofEnablePointSprites();
-   particleTex.bind();
-   vboThrust.draw(GL_POINTS, 0, (int)thrusterEmitter.sys->particles.size());
-
-   ofSetColor(ofColor::yellow);
-   vboCorn.draw(GL_POINTS, 0, (int)cornEmitter.sys->particles.size());
-   particleTex.unbind();
-   shader.end();
-   ofDisablePointSprites();
+   particleRenderer.draw();
 
    // Draw Cams
    if (bShowCams) {
@@ -306,44 +276,42 @@ void ofApp::draw() {
    }
 
    // Draw Models
-   ofPushMatrix();
-   ofNoFill();
-   ofSetColor(ofColor::white);
-   if (bWireframe) {
-      tractor.drawWireframe();
-      cornField.drawWireframe();
-      for (int i = 0; i < corns.size(); i++) {
-         corns[i].drawWireframe();
+   {
+      PROFILE_SCOPE("models");
+      ofPushMatrix();
+      ofNoFill();
+      ofSetColor(ofColor::white);
+      if (bWireframe) {
+         tractor.drawWireframe();
+         cornField.drawWireframe();
+         cornStalks.drawWireframe();
       }
-   }
-   else {
-      // Temporarily disable lighting since model doesnt support lighting
-      ofDisableLighting();
-      tractor.drawFaces();
-      ofEnableLighting();
-
-      ofEnableAlphaBlending();
-      cornField.drawFaces();
-      for (int i = 0; i < corns.size(); i++) {
-         corns[i].drawFaces();
+      else {
+         // Temporarily disable lighting since model doesnt support lighting
+         ofDisableLighting();
+         tractor.drawFaces();
+         ofEnableLighting();
+
+         ofEnableAlphaBlending();
+         cornField.drawFaces();
+         cornStalks.draw();
+         ofDisableAlphaBlending();
       }
-      ofDisableAlphaBlending();
+      ofPopMatrix();
    }
-   ofPopMatrix();
 
    // Draw Bounding Boxes
    if (bBoundingBox) {
-      Vector3 min = shipBox.parameters[0];
-      Vector3 max = shipBox.parameters[1];
+      Vector3 min = snap->shipBox.parameters[0];
+      Vector3 max = snap->shipBox.parameters[1];
       Vector3 size = max - min;
-      Vector3 center = size / 2 + min;
-      ofVec3f p = ofVec3f(center.x(), center.y(), center.z());
+      ofVec3f p = (size / 2 + min).as<ofVec3f>();
       float w = size.x();
       float h = size.y();
       float d = size.z();
       ofDrawBox(p, w, h, d);
 
-      ofVec3f p1 = ofVec3f(min.x(), min.y(), min.z());
+      ofVec3f p1 = min.as<ofVec3f>();
       ofVec3f p2 = ofVec3f(max.x(), min.y(), max.z());
       ofVec3f p3 = ofVec3f(min.x(), min.y(), max.z());
       ofVec3f p4 = ofVec3f(max.x(), min.y(), min.z());
@@ -357,12 +325,11 @@ void ofApp::draw() {
       ofDrawSphere(p4, 0.5);
       ofSetColor(ofColor::purple);
 
-      for (int i = 0; i < landings.size(); i++) {
-         Vector3 min = landings[i].parameters[0];
-         Vector3 max = landings[i].parameters[1];
+      for (int i = 0; i < sim.landings.size(); i++) {
+         Vector3 min = sim.landings[i].parameters[0];
+         Vector3 max = sim.landings[i].parameters[1];
          Vector3 size = max - min;
-         Vector3 center = size / 2 + min;
-         ofVec3f p = ofVec3f(center.x(), center.y(), center.z());
+         ofVec3f p = (size / 2 + min).as<ofVec3f>();
          float w = size.x();
          float h = size.y();
          float d = size.z();
@@ -372,18 +339,18 @@ void ofApp::draw() {
    }
 
    // Draw ray intersect point
-   if (bShowPoint && bPointSelected) {
+   if (bShowPoint && snap->bPointSelected) {
       ofSetColor(ofColor::blue);
-      ofDrawSphere(selectedPoint, 5);
+      ofDrawSphere(snap->selectedPoint, 5);
    }
 
    // Draw Octree
    if (bShowOct) {
       ofPushMatrix();
       ofMultMatrix(cornField.getModelMatrix());
-      oct.drawLeafNodes(oct.root);
-      //oct.draw(oct.root, numLevels, 0, colors); // Draw all levels. RIP FPS
-      //oct.draw(oct.root, 3, 0, colors); // Draw first 3 levels
+      sim.oct.drawLeafNodes(sim.oct.root);
+      //sim.oct.draw(sim.oct.root, sim.numLevels, 0, colors); // Draw all levels. RIP FPS
+      //sim.oct.draw(sim.oct.root, 3, 0, colors); // Draw first 3 levels
       ofPopMatrix();
    }
 
@@ -398,97 +365,28 @@ void ofApp::draw() {
    ofSetColor(ofColor::white);
    ofDrawBitmapString(str, ofGetWindowWidth() - 170, 15);
 
-   str = "Altitude: " + to_string(altitude);
+   str = "Corn: " + to_string(cornScatter.getNumProps()) + " in " + to_string(cornScatter.getNumLoaded()) + " chunks";
+   if (bCulling) str += ", " + to_string(cornScatter.getNumHidden()) + " hidden";
+   ofDrawBitmapString(str, ofGetWindowWidth() - 170, 35);
+
+   str = "Altitude: " + to_string(snap->altitude);
    ofDrawBitmapString(str, ofGetWindowWidth() - 170, 55);
 
+   if (AllocTracker::isEnabled()) {
+      str = "Allocs/frame: " + to_string(AllocTracker::getFrame().allocs);
+      ofDrawBitmapString(str, ofGetWindowWidth() - 170, 70);
+   }
+
    str = "Ship Controls \n UP_ARROW: Forward \n DOWN_ARROW: Back \n";
    str += " LEFT_ARROW: Left \n RIGHT_ARROW : Right \n";
    str += " SPACE: Up \n CTRL: Down \n R: Reset \n";
    str += "Toggles \n B: Bounding Box \n H: GUI \n W: Wireframe \n X: Show Cams\n";
    str += "Camera \n F1: Free Cam \n F2: Fixed Cam \n F3: Landing Cam \n F4: Tracking Cam \n";
+   str += "Profiler \n F5: Show \n F6: Save Trace \n F7: Heap Report \n F8: Occlusion Culling \n";
    ofDrawBitmapString(str, ofGetWindowWidth() - 170, 85);
-}
-
-// Check terrain collision using Octree and ship bounding box
-void ofApp::checkCollision() {
-   ofVec3f contactPt = currentPos;
-   ofVec3f vel = sys->particles[0].velocity;
-   if (vel.y > 0) { 
-      bCollide = false;
-      bLanded = false;
-
-      // Stop harvesting corn when moving up
-      if (vel.y > 0.5 && cornEmitter.started)
-         cornEmitter.stop();
-
-      return;
-   }
-
-   // Get bounding box corners
-   Vector3 min = shipBox.parameters[0];
-   Vector3 max = shipBox.parameters[1];
-   ofVec3f p1 = ofVec3f(min.x(), min.y(), min.z());
-   ofVec3f p2 = ofVec3f(max.x(), min.y(), max.z());
-   ofVec3f p3 = ofVec3f(min.x(), min.y(), max.z());
-   ofVec3f p4 = ofVec3f(max.x(), min.y(), min.z());
-   vector<ofVec3f> points;
-   points.push_back(p1);
-   points.push_back(p2);
-   points.push_back(p3);
-   points.push_back(p4);
-
-   for (int i = 0; i < points.size(); i++) {
-      contactPt = points[i];
-      TreeNode node;
-
-      // Check point intersection, stop checking other points if there is collision
-      if (oct.intersect(contactPt, oct.root, node)) {
-         cout << "Collision" << endl;
-         cout << contactPt << endl;
-         bCollide = true;
-         sys->particles[0].velocity = 
-            ofVec3f(sys->particles[0].velocity.x * 0.5, 
-               -sys->particles[0].velocity.y * 0.5, 
-               sys->particles[0].velocity.z * 0.5);
-
-         // Check if the collision is in a landing area
-         checkLanding();
-         return;
-      }
-      else {
-         bCollide = false;
-      }
-   }
-}
 
-// Check ship's position with landing areas
-void ofApp::checkLanding() {
-   for (int i = 0; i < landings.size(); i++) {
-      if (landings[i].inside(Vector3(currentPos.x, currentPos.y, currentPos.z))) {
-         bLanded = true;
-         return;
-      }
-   }
-   bLanded = false;
-}
-
-// Check ship altitude using ray intersection
-void ofApp::checkAltitude() {
-   ofVec3f rayPoint = currentPos + ofVec3f(0, 10, 0);
-   ofVec3f rayDir = ofVec3f(currentPos.x, currentPos.y - 1000, currentPos.z);
-   rayDir.normalize();
-   Ray ray = Ray(Vector3(rayPoint.x, rayPoint.y, rayPoint.z),
-      Vector3(rayDir.x, rayDir.y, rayDir.z));
-
-   TreeNode rtn;
-   if (oct.intersect(ray, oct.root, rtn)) {
-      bPointSelected = true;
-      selectedPoint = ofVec3f(rtn.box.center().x(), rtn.box.center().y(), rtn.box.center().z());
-      altitude = currentPos.y - selectedPoint.y;
-   }
-   else {
-      bPointSelected = false;
-   }
+   if (bShowProfiler) Profiler::get().draw(10, 10, 300);
+   if (bShowAllocs) ofDrawBitmapString(AllocTracker::getReport(), 10, ofGetWindowHeight() - 110);
 }
 
 /*
@@ -512,56 +410,31 @@ void ofApp::checkAltitude() {
       F2: Fixed Camera
       F3: Landing Camera
       F4: Tracking Camera
+   Profiler
+      F5: Show timing bars (needs COUNTRYROADS_PROFILE)
+      F6: Save Chrome trace to data/trace.json (needs COUNTRYROADS_PROFILE)
+      F7: Show heap allocations per subsystem (needs COUNTRYROADS_TRACK_ALLOCS)
+      F8: Toggle occlusion culling of the corn field
 */
 void ofApp::keyPressed(int key) {
    switch (key) {
    case OF_KEY_UP:
-      moveForce->set(ofVec3f(0, 0, -move));
-      if (!bThrust) {
-         bThrust = true;
-         thrusterEmitter.setVelocity(ofVec3f(0, 0, 100));
-         thrusterEmitter.start();
-      }
+      control(CONTROL_FORWARD, move);
       break;
    case OF_KEY_DOWN:
-      moveForce->set(ofVec3f(0, 0, move));
-      if (!bThrust) {
-         bThrust = true;
-         thrusterEmitter.setVelocity(ofVec3f(0, 0, -100));
-         thrusterEmitter.start();
-      }
+      control(CONTROL_BACK, move);
       break;
    case OF_KEY_LEFT:
-      moveForce->set(ofVec3f(-move, 0));
-      if (!bThrust) {
-         bThrust = true;
-         thrusterEmitter.setVelocity(ofVec3f(100, 0, 0));
-         thrusterEmitter.start();
-      }
+      control(CONTROL_LEFT, move);
       break;
    case OF_KEY_RIGHT:
-      moveForce->set(ofVec3f(move, 0));
-      if (!bThrust) {
-         bThrust = true;
-         thrusterEmitter.setVelocity(ofVec3f(-100, 0, 0));
-         thrusterEmitter.start();
-      }
+      control(CONTROL_RIGHT, move);
       break;
    case OF_KEY_CONTROL:
-      moveForce->set(ofVec3f(0, -move, 0));
-      if (!bThrust) {
-         bThrust = true;
-         thrusterEmitter.setVelocity(ofVec3f(0, 100, 0));
-         thrusterEmitter.start();
-      }
+      control(CONTROL_DOWN, move);
       break;
    case ' ':
-      moveForce->set(ofVec3f(0, move, 0));
-      if (!bThrust) {
-         bThrust = true; 
-         thrusterEmitter.setVelocity(ofVec3f(0, -100, 0));
-         thrusterEmitter.start();
-      }
+      control(CONTROL_UP, move);
       break;
    case 'b':
       bBoundingBox = !bBoundingBox;
@@ -585,8 +458,11 @@ void ofApp::keyPressed(int key) {
       bPaused = !bPaused;
       break;
    case 'r':
-      sys->particles[0].position = glm::vec3(0, 30, 0);
-      sys->particles[0].velocity = glm::vec3(0, 0, 0);
+      control(CONTROL_RESET, 0);
+      break;
+   case 'v':
+      // check the particle uploads against the systems
+      cout << "Particle buffer mismatches: " << particleRenderer.verify() << endl;
       break;
    case 'w':
       bWireframe = !bWireframe;
@@ -606,6 +482,19 @@ void ofApp::keyPressed(int key) {
    case OF_KEY_F4:
       theCam = &trackingCam;
       break;
+   case OF_KEY_F5:
+      bShowProfiler = !bShowProfiler;
+      break;
+   case OF_KEY_F7:
+      bShowAllocs = !bShowAllocs;
+      break;
+   case OF_KEY_F8:
+      bCulling = !bCulling;
+      break;
+   case OF_KEY_F6:
+      if (Profiler::get().writeChromeTrace(ofToDataPath("trace.json")))
+         cout << "Saved trace: " << ofToDataPath("trace.json") << endl;
+      break;
    default:
       break;
    }
@@ -617,46 +506,38 @@ void ofApp::keyPressed(int key) {
 void ofApp::keyReleased(int key) {
    switch (key) {
    case OF_KEY_UP:
-      moveForce->set(ofVec3f(0, 0));
-      bThrust = false;
-      thrusters.stop();
-      thrusterEmitter.stop();
-      break;
    case OF_KEY_DOWN:
-      moveForce->set(ofVec3f(0, 0));
-      bThrust = false;
-      thrusters.stop();
-      thrusterEmitter.stop();
-      break;
    case OF_KEY_LEFT:
-      moveForce->set(ofVec3f(0, 0));
-      bThrust = false;
-      thrusters.stop();
-      thrusterEmitter.stop();
-      break;
    case OF_KEY_RIGHT:
-      moveForce->set(ofVec3f(0, 0));
-      bThrust = false;
-      thrusters.stop();
-      thrusterEmitter.stop();
-      break;
    case OF_KEY_CONTROL:
-      moveForce->set(ofVec3f(0, 0, 0));
-      bThrust = false;
-      thrusters.stop();
-      thrusterEmitter.stop();
-      break;
    case ' ':
-      moveForce->set(ofVec3f(0, 0, 0));
-      bThrust = false;
-      thrusters.stop();
-      thrusterEmitter.stop();
+      control(CONTROL_RELEASE, 0);
       break;
    default:
       break;
    }
 }
 
+//--------------------------------------------------------------
+void ofApp::exit() {
+   simThread.stop();
+   if (bRecording) {
+      input.steps = simThread.getStepCount();
+      input.hash = sim.trajectoryHash;
+      if (input.save(recordPath))
+         cout << "Saved recording: " << recordPath << " (" << input.events.size() << " events, "
+            << input.steps << " steps)" << endl;
+   }
+}
+
+// Ship controls are passed to the simulation thread, which records them
+// (or ignores them while a recording is replayed)
+//
+void ofApp::control(Control c, float value) {
+   if (!simThread.control(c, value))
+      cout << "Control queue full, dropped control " << c << endl;
+}
+
 //--------------------------------------------------------------
 void ofApp::mouseMoved(int x, int y) {
 
@@ -739,39 +620,3 @@ void ofApp::initLightingAndMaterials() {
    glEnable(GL_LIGHT1);
    glShadeModel(GL_SMOOTH);
 }
-
-// load vertex buffer in preparation for rendering
-//
-void ofApp::loadVboThrust() {
-   if (thrusterEmitter.sys->particles.size() < 1) return;
-
-   vector<ofVec3f> sizes;
-   vector<ofVec3f> points;
-   for (int i = 0; i < thrusterEmitter.sys->particles.size(); i++) {
-      points.push_back(thrusterEmitter.sys->particles[i].position);
-      sizes.push_back(ofVec3f(radius));
-   }
-   // upload the data to the vbo
-   //
-   int total = (int)points.size();
-   vboThrust.clear();
-   vboThrust.setVertexData(&points[0], total, GL_STATIC_DRAW);
-   vboThrust.setNormalData(&sizes[0], total, GL_STATIC_DRAW);
-}
-
-void ofApp::loadVboCorn() {
-   if (cornEmitter.sys->particles.size() < 1) return;
-
-   vector<ofVec3f> sizes;
-   vector<ofVec3f> points;
-   for (int i = 0; i < cornEmitter.sys->particles.size(); i++) {
-      points.push_back(cornEmitter.sys->particles[i].position);
-      sizes.push_back(ofVec3f(radius));
-   }
-   // upload the data to the vbo
-   //
-   int total = (int)points.size();
-   vboCorn.clear();
-   vboCorn.setVertexData(&points[0], total, GL_STATIC_DRAW);
-   vboCorn.setNormalData(&sizes[0], total, GL_STATIC_DRAW);
-}
\ No newline at end of file
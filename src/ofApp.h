@@ -3,11 +3,15 @@
 #include "ofMain.h"
 #include "ofxGui.h"
 #include "ofxAssimpModelLoader.h"
-#include "ParticleSystem.h"
-#include "ParticleEmitter.h"
-#include "Particle.h"
-#include "box.h"
-#include "Octree.h"
+#include "Simulation.h"
+#include "SimThread.h"
+#include "ParticleRenderer.h"
+#include "PropRenderer.h"
+#include "PropScatter.h"
+#include "OcclusionCuller.h"
+#include "Profiler.h"
+#include "InputRecorder.h"
+#include "AllocTracker.h"
 
 class ofApp : public ofBaseApp {
 
@@ -15,9 +19,7 @@ public:
    void setup();
    void update();
    void draw();
-   void checkCollision();
-   void checkLanding();
-   void checkAltitude();
+   void exit();
 
    void keyPressed(int key);
    void keyReleased(int key);
@@ -31,47 +33,40 @@ public:
    void dragEvent(ofDragInfo dragInfo);
    void gotMessage(ofMessage msg);
    void initLightingAndMaterials();
-   void loadVboThrust();
-   void loadVboCorn();
+   void control(Control c, float value);
 
 
-   // Particle System
-   ParticleSystem *sys;
-   GravityForce *grav;
-   MovementForce *moveForce;
-   TurbulenceForce *turb;
-   Particle ship;
+   // Ship, particles, terrain collision; everything but the drawing.
+   // Stepped on simThread, the app only reads the snapshots it publishes.
+   Simulation sim;
+   SimThread simThread{ sim };
+   const SimSnapshot *snap;
 
-   ParticleEmitter thrusterEmitter;
-   ImpulseRadialForce *radialForce;
-   CyclicForce *cyclicForce;
+   // All particle systems drawn in one batch
+   ParticleRenderer particleRenderer;
+   int thrustLayer, cornLayer;
 
-   ofTexture  particleTex;
-   ofVbo vboThrust, vboCorn;
-   ofShader shader;
-
-   ParticleEmitter cornEmitter;
-   ImpulseRadialForce *radialCorn;
-   CyclicForce *cyclicCorn;
-
-   // Models
+   // Models.  The corn stalk is loaded once and drawn instanced.
    ofxAssimpModelLoader tractor, cornField, corn;
-   vector<ofxAssimpModelLoader> corns;
+   PropRenderer cornStalks;
+
+   // Corn field, scattered over the terrain and streamed in chunks around
+   // the ship.  Chunks are generated on loaderJobs, off the simulation's pool.
+   JobPool loaderJobs{ 1 };
+   TerrainPatches terrainPatches;   // heights for the corn and the culler
+   PropScatter cornScatter;
+   vector<PropRenderer::Instance> cornInstances;
+   float scatterRadius;
+
+   // Corn chunks hidden behind the terrain are left out of the draw
+   OcclusionCuller culler;
+   bool bCulling;
    ofMesh cornMesh;
-   Box shipBox;
-   float altitude;
-   ofVec3f currentPos;
+   ofVec3f renderPos;      // ship position interpolated between the last two steps
    bool bWireframe;
    bool bBoundingBox;
-   bool bCollide;
-   bool bLanded;
-
-   // Landing Areas
-   vector<Box> landings;
 
    // Octree
-   Octree oct;
-   int numLevels;
    vector<ofColor> colors;
    bool bShowOct;
 
@@ -83,7 +78,6 @@ public:
 
    // Sounds
    ofSoundPlayer countryRoads, thrusters;
-   bool bThrust;
 
    // Lighting
    ofLight sunLight;
@@ -92,13 +86,23 @@ public:
    bool bHide;
    ofxFloatSlider camDistance;
    ofxFloatSlider gravity;
+   float gravityControl;   // last gravity sent to the simulation
    ofxFloatSlider move;
    ofxFloatSlider radius;
    ofxPanel gui;
 
+   // Input recording (--record file) and replay (--replay file)
+   InputRecorder input;
+   string recordPath, replayPath;
+   bool bRecording;
+
+   // Profiler HUD (needs COUNTRYROADS_PROFILE)
+   bool bShowProfiler;
+
+   // Heap allocation report (needs COUNTRYROADS_TRACK_ALLOCS)
+   bool bShowAllocs;
+
    // Test
-   bool bPointSelected;
    bool bShowPoint;
-   ofVec3f selectedPoint;
    bool bPaused;
 };
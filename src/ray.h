@@ -16,7 +16,7 @@
 class Ray {
   public:
     Ray() { }
-    Ray(Vector3 o, Vector3 d) {
+    Ray(const Vector3 &o, const Vector3 &d) {
       origin = o;
       direction = d;
       inv_direction = Vector3(1/d.x(), 1/d.y(), 1/d.z());
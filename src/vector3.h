@@ -2,20 +2,41 @@
 #define _VECTOR3_H_
 
 #include <math.h>
+#include <utility>
 
-class Vector3 {
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define VECTOR3_SSE 1
+#include <emmintrin.h>
+#endif
+
+/*
+ * 16 byte aligned 3-vector.  The fourth lane is padding and kept at 0, so
+ * the component-wise operators are one SSE instruction each (plain float
+ * code without SSE) and give bit-identical results to the scalar math.
+ * The SSE Box::intersect in box.cc answers like the scalar one, including
+ * the NaN cases of axis-parallel rays.
+ *
+ * Anything with float x, y, z members (ofVec3f, glm::vec3) converts
+ * implicitly, so collision code can hand the openFrameworks types straight
+ * to Box and Ray; as<T>() converts back.
+ */
+
+class alignas(16) Vector3 {
   public:
     Vector3() { };
-    Vector3(float x, float y, float z) { d[0] = x; d[1] = y; d[2] = z; }
-    Vector3(const Vector3 &v)
-      { d[0] = v.d[0]; d[1] = v.d[1]; d[2] = v.d[2]; }
+    Vector3(float x, float y, float z) { set(x, y, z); }
+    template <typename V, typename = decltype(std::declval<const V &>().z + 0.0f)>
+    Vector3(const V &v) { set(v.x, v.y, v.z); }
 
     float x() const { return d[0]; }
     float y() const { return d[1]; }
     float z() const { return d[2]; }
 
     float operator[](int i) const { return d[i]; }
-    
+
+    template <typename V>
+    V as() const { return V(d[0], d[1], d[2]); }
+
     float length() const
       { return sqrt(d[0]*d[0] + d[1]*d[1] + d[2]*d[2]); }
     void normalize() {
@@ -32,7 +53,38 @@ class Vector3 {
     /////////////////////////////////////////////////////////
     // Overloaded operators
     /////////////////////////////////////////////////////////
-  
+
+#ifdef VECTOR3_SSE
+    Vector3 operator+(const Vector3 &op2) const {   // vector addition
+      return Vector3(_mm_add_ps(m, op2.m));
+    }
+    Vector3 operator-(const Vector3 &op2) const {   // vector subtraction
+      return Vector3(_mm_sub_ps(m, op2.m));
+    }
+    Vector3 operator-() const {                    // unary minus
+      return Vector3(_mm_sub_ps(_mm_setzero_ps(), m));
+    }
+    Vector3 operator*(float s) const {            // scalar multiplication
+      return Vector3(_mm_mul_ps(m, _mm_set1_ps(s)));
+    }
+    void operator*=(float s) {
+      m = _mm_mul_ps(m, _mm_set1_ps(s));
+    }
+    Vector3 operator/(float s) const {            // scalar division
+      return Vector3(_mm_div_ps(m, _mm_set1_ps(s)));
+    }
+    Vector3 mul(const Vector3 &op2) const {       // component-wise product
+      return Vector3(_mm_mul_ps(m, op2.m));
+    }
+    static Vector3 minimum(const Vector3 &a, const Vector3 &b)
+      { return Vector3(_mm_min_ps(a.m, b.m)); }
+    static Vector3 maximum(const Vector3 &a, const Vector3 &b)
+      { return Vector3(_mm_max_ps(a.m, b.m)); }
+
+    // raw lanes, for the SSE kernels in box.cc
+    explicit Vector3(__m128 v) : m(v) { }
+    __m128 simd() const { return m; }
+#else
     Vector3 operator+(const Vector3 &op2) const {   // vector addition
       return Vector3(d[0] + op2.d[0], d[1] + op2.d[1], d[2] + op2.d[2]);
     }
@@ -53,6 +105,18 @@ class Vector3 {
     Vector3 operator/(float s) const {            // scalar division
       return Vector3(d[0] / s, d[1] / s, d[2] / s);
     }
+    Vector3 mul(const Vector3 &op2) const {       // component-wise product
+      return Vector3(d[0] * op2.d[0], d[1] * op2.d[1], d[2] * op2.d[2]);
+    }
+    static Vector3 minimum(const Vector3 &a, const Vector3 &b) {
+      return Vector3(a.d[0] < b.d[0] ? a.d[0] : b.d[0], a.d[1] < b.d[1] ? a.d[1] : b.d[1],
+                    a.d[2] < b.d[2] ? a.d[2] : b.d[2]);
+    }
+    static Vector3 maximum(const Vector3 &a, const Vector3 &b) {
+      return Vector3(a.d[0] > b.d[0] ? a.d[0] : b.d[0], a.d[1] > b.d[1] ? a.d[1] : b.d[1],
+                    a.d[2] > b.d[2] ? a.d[2] : b.d[2]);
+    }
+#endif
     float operator*(const Vector3 &op2) const {   // dot product
       return d[0] * op2.d[0] + d[1] * op2.d[1] + d[2] * op2.d[2];
     }
@@ -72,9 +136,24 @@ class Vector3 {
     bool operator<=(const Vector3 &op2) const {
       return (d[0] <= op2.d[0] && d[1] <= op2.d[1] && d[2] <= op2.d[2]);
     }
-  
+
   private:
-    float d[3];
+    void set(float x, float y, float z) {
+#ifdef VECTOR3_SSE
+      m = _mm_set_ps(0, z, y, x);
+#else
+      d[0] = x; d[1] = y; d[2] = z; d[3] = 0;
+#endif
+    }
+
+#ifdef VECTOR3_SSE
+    union {
+      __m128 m;
+      float d[4];
+    };
+#else
+    float d[4];
+#endif
 };
 
 #endif // _VECTOR3_H_